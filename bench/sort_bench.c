@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 200809L
+#include <splatc/sort.h>
+#include <splatc/threadpool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Depth sort of n splats with uniformly random depths, the way preprocess
+ * used to do it, qsort on the projected records, against the radix sort of
+ * the depth keys followed by one gather of the records.
+ *
+ *   bin/sort_bench [n] [threads]
+ */
+
+/* as large as a projected splat */
+typedef struct {
+  float v[4];
+  float f[2];
+  size_t idx;
+  uint32_t inst;
+} bench_point;
+
+static int
+bench_compare(const void *a, const void *b) {
+  float z0 = ((const bench_point *)a)->v[2];
+  float z1 = ((const bench_point *)b)->v[2];
+  return (z0 > z1) - (z0 < z1);
+}
+
+static double
+bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main(int argc, char **argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  size_t n_threads = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  tpool *pool = n_threads > 1 ? tpool_create(n_threads) : NULL;
+
+  bench_point *points = malloc(n * sizeof(bench_point));
+  bench_point *qsorted = malloc(n * sizeof(bench_point));
+  bench_point *gathered = malloc(n * sizeof(bench_point));
+  uint32_t *keys = malloc(4 * n * sizeof(uint32_t));
+  if (!points || !qsorted || !gathered || !keys) {
+    printf("[bench] out of memory for %zu points\n", n);
+    return 1;
+  }
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    points[i] = (bench_point){.v = {0.f, 0.f, 50.f * rand() / RAND_MAX, 1.f},
+                              .idx = i};
+  }
+
+  memcpy(qsorted, points, n * sizeof(bench_point));
+  double start = bench_now();
+  qsort(qsorted, n, sizeof(bench_point), bench_compare);
+  double qsort_time = bench_now() - start;
+
+  start = bench_now();
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = sort_float_key(points[i].v[2]);
+    keys[n + i] = i;
+  }
+  sort_radix_u32(pool, keys, keys + n, keys + 2 * n, keys + 3 * n, n);
+  for (size_t i = 0; i < n; ++i) {
+    gathered[i] = points[keys[n + i]];
+  }
+  double radix_time = bench_now() - start;
+
+  /* qsort is not stable, ties may be in either order */
+  for (size_t i = 0; i < n; ++i) {
+    if (gathered[i].v[2] != qsorted[i].v[2] ||
+        (i > 0 && gathered[i - 1].v[2] == gathered[i].v[2] &&
+         gathered[i - 1].idx > gathered[i].idx)) {
+      printf("[bench] orders differ at %zu\n", i);
+      return 1;
+    }
+  }
+
+  printf("n = %zu, %zu threads: qsort %.1f ms, radix sort + gather %.1f ms\n",
+         n, n_threads, qsort_time * 1e3, radix_time * 1e3);
+
+  free(points);
+  free(qsorted);
+  free(gathered);
+  free(keys);
+  if (pool) tpool_destroy(pool);
+  return 0;
+}
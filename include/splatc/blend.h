@@ -0,0 +1,55 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "linalg.h"
+
+#define BLEND_BATCH_SIZE 16 /* pixels per kernel step, 16 AVX-512 lanes */
+#define BLEND_MAX_ALPHA 0.99f
+#define BLEND_MIN_TRANSMITTANCE 0.001f /* below which a pixel is saturated */
+
+/*
+ * What the render kernel reads of a visible splat, packed so that each splat
+ * of a tile costs one or two cache lines rather than one per attribute.
+ */
+typedef struct {
+  vec2f mean;   /* in pixels */
+  vec3f conic;  /* inverse 2D covariance (a, b, c) */
+  vec3f color;
+  float opacity;
+  vec2f extent; /* half size in pixels */
+} blend_splat;
+
+/*
+ * One tile of the frame in SoA form, one lane per pixel. The pixel arrays are
+ * stride pixels wide and rounded up to a multiple of BLEND_BATCH_SIZE.
+ */
+typedef struct {
+  int x0, y0;        /* of the tile in the frame */
+  int width, height; /* of the part inside the frame */
+  int stride;        /* pixels per row of the arrays */
+  const float *cols; /* column of each pixel within the tile */
+  const float *rows; /* row of each pixel within the tile */
+  float *color[3];
+  float *transmittance;
+  float min_alpha; /* below which a splat leaves a pixel alone */
+} blend_tile;
+
+/* blend kernels, specialized for one instruction set */
+typedef struct {
+  cpu_isa isa;
+  /*
+   * blends splats[visible[0]], ..., splats[visible[n - 1]] front to back,
+   * until every pixel of the tile is saturated
+   */
+  void (*splats)(blend_tile *tile, const blend_splat *splats,
+                 const uint32_t *visible, size_t n);
+} blend_kernels;
+
+/* the kernels for isa, or for the best extension below it that was built */
+blend_kernels blend_get_kernels(cpu_isa isa);
+
+#endif
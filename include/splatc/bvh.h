@@ -0,0 +1,65 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "linalg.h"
+#include "loader.h"
+#include "threadpool.h"
+
+#define BVH_LEAF_SIZE 256 /* points per leaf, at most */
+#define BVH_MAX_DEPTH 64  /* of the traversal stack */
+
+/* box around the 3 sigma ellipsoids of the points [begin, begin + count) */
+typedef struct {
+  vec3f min;
+  vec3f max;
+  uint32_t begin;
+  uint32_t count;
+  uint32_t left; /* children left and left + 1, 0 for leaves */
+} bvh_node;
+
+/*
+ * Bounding volume hierarchy over contiguous runs of points. It only culls
+ * well if the points are in a spatially coherent order, e.g. after
+ * LOADER_REORDER_MORTON.
+ */
+struct gsbvh_t {
+  bvh_node *nodes; /* nodes[0] is the root */
+  size_t n_nodes;
+  size_t n_points; /* of the model when the hierarchy was built */
+};
+
+/* view frustum in view space, looking down +z */
+typedef struct {
+  float tan_fovx;
+  float tan_fovy;
+  float near;
+  float far;
+} bvh_frustum;
+
+gsbvh *bvh_build(const gsmodel *model, tpool *pool);
+
+void bvh_destroy(gsbvh *bvh);
+
+/*
+ * Center and half extents in view space of a box around the model space box
+ * [min, max], model_view maps model space to view space in the row vector
+ * convention.
+ */
+void bvh_box_to_view(vec3f min, vec3f max, const mat4 *model_view,
+                     vec3f *center, vec3f *extent);
+
+/* conservative test of a view space box against the frustum */
+int bvh_view_box_visible(vec3f center, vec3f extent,
+                         const bvh_frustum *frustum);
+
+/*
+ * Conservative test of a node against the frustum, model_view maps model
+ * space to view space in the row vector convention.
+ */
+int bvh_node_visible(const bvh_node *node, const mat4 *model_view,
+                     const bvh_frustum *frustum);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef CPU_H
+#define CPU_H
+
+/* instruction set extensions that kernels can be specialized for */
+typedef enum {
+  CPU_ISA_SCALAR, /* portable C, whatever the compiler targets by default */
+  CPU_ISA_SSE4,   /* SSE4.1 */
+  CPU_ISA_AVX2,   /* AVX2 and FMA */
+  CPU_ISA_AVX512, /* AVX-512 F */
+} cpu_isa;
+
+/*
+ * The best extension the CPU supports. Setting the environment variable
+ * SPLATC_ISA to scalar, sse4, avx2 or avx512 caps it, e.g. to compare kernels.
+ */
+cpu_isa cpu_detect_isa();
+
+const char *cpu_isa_name(cpu_isa isa);
+
+#endif
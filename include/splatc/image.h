@@ -0,0 +1,10 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+#include <stdint.h>
+#include <stdlib.h>
+
+/* decodes a PNG (or WebP if built with SPLATC_WITH_WEBP) image into tightly
+ * packed 8-bit RGBA pixels, returns NULL on failure. free with free() */
+uint8_t* image_read_rgba(const char* fn, size_t* width, size_t* height);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+typedef enum {
+  JSON_NULL,
+  JSON_BOOL,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT
+} json_type;
+
+typedef struct json_value json_value;
+
+struct json_value {
+  json_type type;
+  double number; /* numbers and booleans */
+  char *string;
+  size_t n_children; /* array elements or object members */
+  json_value *children;
+  char **keys; /* object member names, parallel to children */
+};
+
+json_value *json_parse(const char *text, size_t len);
+json_value *json_parse_file(const char *fn);
+
+/* lookups return NULL if the key or index does not exist */
+const json_value *json_get(const json_value *object, const char *key);
+const json_value *json_at(const json_value *array, size_t i);
+
+size_t json_length(const json_value *value);
+double json_number(const json_value *value, double fallback);
+const char *json_string(const json_value *value);
+
+void json_destroy(json_value *value);
+
+#endif
@@ -81,6 +81,12 @@ vec4f matmulv4(mat4 b, vec4f a);
 
 mat3 transpose3(mat3 m);
 mat4 transpose4(mat4 m);
+
+/* zero matrix if m is singular */
+mat3 inverse3(mat3 m);
+
+/* rotation matrix of a normalized quaternion (w, x, y, z) */
+mat3 quat_to_mat3(vec4f q);
 /* end matrix ops */
 
 #endif
@@ -2,23 +2,127 @@
 #define LOADER_H
 
 #include <splatc/linalg.h>
+#include <splatc/threadpool.h>
+
+#define LOADER_DEFAULT_THREADS 16
+#define LOADER_PRUNE_OPACITY (1.f / 255.f) /* never reaches the 1/255 alpha */
+
+typedef struct gsmodel_quantized_t gsmodel_quantized;
+typedef struct gsbvh_t gsbvh;
+typedef struct gslod_t gslod;
 
 typedef struct {
   long n_points;
   vec3f* positions;
   vec3f* colors;
   float* opacities;
-  mat3* cov3d;
+  vec3f* scales;    /* activated, the covariance is R S S^T R^T */
+  vec4f* rotations; /* normalized quaternions (w, x, y, z) */
+
+  /* view-dependent color, sh_num_coeffs(sh_degree) rgb triplets per point */
+  int sh_degree;
+  float* sh;
+
+  /* if set, replaces all of the float arrays above */
+  gsmodel_quantized* quantized;
+
+  /* optional hierarchy of point bounds for frustum culling, see bvh.h */
+  gsbvh* bvh;
+
+  /* optional hierarchy of merged splats for level of detail, see lod.h */
+  gslod* lod;
+
+  /* set if the arrays point into a mapped .splatc file instead of the heap */
+  void* mapping;
+  size_t mapping_size;
 } gsmodel;
 
-gsmodel* loader_gsmodel_from_splat(const char* fn);
+typedef enum {
+  LOADER_CACHE_OFF,
+  LOADER_CACHE_AUTO, /* read or write <fn>.splatc next to the source file */
+} loader_cache_mode;
+
+typedef enum {
+  LOADER_REORDER_OFF,
+  LOADER_REORDER_MORTON, /* sort the points along a Morton curve */
+} loader_reorder_mode;
+
+/* reports that points [0, n_ready) of model are decoded */
+typedef void (*loader_progress_func)(void* user, const gsmodel* model,
+                                     size_t n_ready);
+
+typedef struct {
+  tpool* pool;      /* worker pool used for decoding, may be NULL */
+  size_t n_threads; /* size of a temporary pool if no pool is given */
+  loader_cache_mode cache;
+  int quantize; /* keep the model in compact quantized form */
+
+  /* splats below either threshold are dropped after loading, 0 disables */
+  float prune_opacity;
+  float prune_scale; /* largest axis of the activated scale */
+
+  /* spatially coherent point order, applied after pruning */
+  loader_reorder_mode reorder;
+  int build_bvh; /* build model->bvh, implies a Morton order */
+  int build_lod; /* build model->lod, implies a Morton order */
+
+  /*
+   * Called from the loading thread as decoding progresses, only if none of
+   * the passes above are requested since they rewrite the arrays.
+   */
+  loader_progress_func progress;
+  void* progress_user;
+} loader_options;
+
+typedef enum {
+  LOADER_ASYNC_LOADING,
+  LOADER_ASYNC_DONE,
+  LOADER_ASYNC_FAILED,
+} loader_async_state;
+
+typedef struct loader_async_t loader_async;
+
+/* picks the loader from the file extension and handles the cache mode */
+gsmodel* loader_gsmodel_load(const char* fn, const loader_options* opts);
+
+gsmodel* loader_gsmodel_from_splat(const char* fn, const loader_options* opts);
 
 gsmodel* loader_gsmodel_debug();
 
-gsmodel* loader_gsmodel_from_sogs(const char* fn);
+gsmodel* loader_gsmodel_from_sogs(const char* fn, const loader_options* opts);
+
+gsmodel* loader_gsmodel_from_ply(const char* fn, const loader_options* opts);
 
-gsmodel* loader_gsmodel_from_ply(const char* fn);
+gsmodel* loader_gsmodel_from_splatc(const char* fn);
+
+int loader_gsmodel_write_splatc(const gsmodel* model, const char* fn);
+
+/*
+ * Writes a .splatc file whose points are grouped into spatial chunks of at
+ * most chunk_size points, with a chunk table for out-of-core streaming.
+ */
+int loader_gsmodel_write_splatc_chunked(const gsmodel* model, const char* fn,
+                                        size_t chunk_size);
 
 void loader_gsmodel_destroy(gsmodel* model);
 
+/* runs loader_gsmodel_load on a background thread */
+loader_async* loader_gsmodel_load_async(const char* fn,
+                                        const loader_options* opts);
+
+/*
+ * The model being loaded, initially empty. Only loader_async_poll changes
+ * it, so it can be rendered between polls.
+ */
+gsmodel* loader_async_model(loader_async* async);
+
+/* grows the model to the points loaded so far */
+loader_async_state loader_async_poll(loader_async* async);
+
+/*
+ * Waits for the background thread and releases the handle. Returns the
+ * completed model, or NULL if loading failed.
+ */
+gsmodel* loader_async_finish(loader_async* async);
+
 #endif
@@ -0,0 +1,57 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stddef.h>
+
+#include "bvh.h"
+#include "linalg.h"
+#include "loader.h"
+#include "threadpool.h"
+
+#define LOD_FANOUT 4      /* children per node */
+#define LOD_MAX_LEVELS 32 /* enough for 4^31 points */
+
+/* box around the 3 sigma ellipsoids of the points below a node */
+typedef struct {
+  vec3f min;
+  vec3f max;
+} lod_box;
+
+/*
+ * Level of detail hierarchy over contiguous runs of points. A node of level 1
+ * merges LOD_FANOUT consecutive points, a node of level l > 1 as many
+ * consecutive nodes of level l - 1, up to a single root. Each node carries one
+ * splat whose weighted mean, covariance and color match those of the points
+ * below it. Like gsbvh, it only works well on a spatially coherent order.
+ */
+struct gslod_t {
+  gsmodel *parents; /* the splat of each node, level by level, no SH */
+  lod_box *boxes;   /* of each node */
+  /* nodes of level l are [level_offsets[l - 1], level_offsets[l]) */
+  size_t level_offsets[LOD_MAX_LEVELS + 1];
+  int n_levels;
+  size_t n_points; /* of the model when the hierarchy was built */
+};
+
+/* what a frame does with a node */
+typedef enum {
+  LOD_HIDDEN,  /* culled, or an ancestor stands in for it */
+  LOD_DRAWN,   /* its splat stands in for the points below it */
+  LOD_REFINED, /* its children are drawn or refined */
+} lod_state;
+
+/* NULL for models of less than two points */
+gslod *lod_build(const gsmodel *model, tpool *pool);
+
+void lod_destroy(gslod *lod);
+
+/*
+ * State of node given the state of its parent, LOD_REFINED for the root. The
+ * node is drawn once its box spans less than threshold pixels at the focal
+ * length focal, model_view maps model space to view space.
+ */
+lod_state lod_node_state(const gslod *lod, size_t node, lod_state parent,
+                         const mat4 *model_view, const bvh_frustum *frustum,
+                         float focal, float threshold);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "linalg.h"
+
+#define PROJECT_BATCH_SIZE 16 /* splats per kernel call, 16 AVX-512 lanes */
+
+/* per-frame constants of the projection */
+typedef struct {
+  mat4 proj;
+  float focal_x;
+  float focal_y;
+  float tan_fovx;
+  float tan_fovy;
+  float width; /* of the frame in pixels */
+  float height;
+  float min_alpha; /* below which the render kernel skips a splat */
+} project_params;
+
+/* splat means of one model in SoA form, one lane per splat */
+typedef struct {
+  float position[3][PROJECT_BATCH_SIZE]; /* in model space */
+  /* results */
+  float view[4][PROJECT_BATCH_SIZE];   /* mean in view space */
+  float screen[2][PROJECT_BATCH_SIZE]; /* mean in pixels */
+  int32_t visible[PROJECT_BATCH_SIZE]; /* inside the view frustum */
+} project_points;
+
+/* visible splats in SoA form, one lane per splat */
+typedef struct {
+  float view[3][PROJECT_BATCH_SIZE];   /* mean in view space */
+  float screen[2][PROJECT_BATCH_SIZE]; /* mean in pixels */
+  float W[9][PROJECT_BATCH_SIZE];      /* model to view rotation, row major */
+  float scale[3][PROJECT_BATCH_SIZE];
+  float rotation[4][PROJECT_BATCH_SIZE]; /* quaternion (w, x, y, z) */
+  float opacity[PROJECT_BATCH_SIZE];
+  /* results */
+  float conic[3][PROJECT_BATCH_SIZE]; /* inverse 2D covariance (a, b, c) */
+  /* -power at which alpha reaches params.min_alpha, 0 if culled */
+  float cutoff[PROJECT_BATCH_SIZE];
+  /* half size of the box around the ellipse of the cutoff, in pixels */
+  float extent[2][PROJECT_BATCH_SIZE];
+  /* floored min x, y and exclusive max x, y of the reachable pixels */
+  float rect[4][PROJECT_BATCH_SIZE];
+} project_splats;
+
+/* batch kernels, specialized for one instruction set */
+typedef struct {
+  cpu_isa isa;
+  /* transforms the means by the row vector model_view and culls them */
+  void (*points)(project_points *batch, const mat4 *model_view,
+                 const project_params *params);
+  /* projects the 3D covariances, see project_splats for the results */
+  void (*splats)(project_splats *batch, const project_params *params);
+} project_kernels;
+
+/* the kernels for isa, or for the best extension below it that was built */
+project_kernels project_get_kernels(cpu_isa isa);
+
+#endif
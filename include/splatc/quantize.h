@@ -0,0 +1,129 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "linalg.h"
+#include "loader.h"
+#include "threadpool.h"
+
+#define QUANTIZE_CHUNK_SIZE 256 /* points sharing one position range */
+
+typedef struct {
+  vec3f min;
+  vec3f step; /* extent / 65535 */
+} quantized_chunk;
+
+#define QUANTIZE_ROTATION_MAX 1023.f /* 10 bits per stored component */
+#define QUANTIZE_SQRT2 1.41421356f
+
+/*
+ * Compact storage for a gsmodel: 16-bit positions relative to the bounds of
+ * their chunk, 8-bit color and opacity, half float scales, quaternions packed
+ * as their three smallest components (10 bits each) plus the index of the
+ * largest one, and half float SH coefficients. 20 bytes per point before SH
+ * instead of 56.
+ */
+struct gsmodel_quantized_t {
+  quantized_chunk *chunks;
+  uint16_t *positions; /* xyz per point */
+  uint8_t *colors;     /* rgb and opacity per point */
+  uint16_t *scales;    /* xyz per point */
+  uint32_t *rotations; /* largest index << 30 | three 10-bit components */
+  uint16_t *sh;
+
+  float color_min;
+  float color_step;
+  float scale_mult; /* scales are stored multiplied by this */
+
+  /* largest decode errors over all points, measured when quantizing */
+  float position_error; /* absolute, in model units */
+  float color_error;    /* absolute */
+  float opacity_error;  /* absolute */
+  float scale_error;    /* relative */
+  float rotation_error; /* absolute, per quaternion component */
+  float sh_error;       /* absolute */
+};
+
+/* builds the quantized form of a full precision model */
+gsmodel_quantized *quantize_gsmodel(const gsmodel *model, tpool *pool);
+
+void quantize_destroy(gsmodel_quantized *q);
+
+uint16_t quantize_float_to_half(float f);
+
+static inline float
+quantize_half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  uint32_t bits;
+
+  if (exp == 0) {
+    /* zero or subnormal, both are exact multiples of 2^-24 */
+    float f = mant * (1.f / 16777216.f);
+    return sign ? -f : f;
+  } else if (exp == 31) {
+    bits = sign | 0x7F800000 | (mant << 13);
+  } else {
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  }
+
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+static inline vec3f
+quantize_decode_position(const gsmodel_quantized *q, size_t i) {
+  const quantized_chunk *chunk = &q->chunks[i / QUANTIZE_CHUNK_SIZE];
+  const uint16_t *p = q->positions + 3 * i;
+  return (vec3f){{chunk->min.x + p[0] * chunk->step.x,
+                  chunk->min.y + p[1] * chunk->step.y,
+                  chunk->min.z + p[2] * chunk->step.z}};
+}
+
+static inline vec3f
+quantize_decode_color(const gsmodel_quantized *q, size_t i) {
+  const uint8_t *c = q->colors + 4 * i;
+  return (vec3f){{q->color_min + c[0] * q->color_step,
+                  q->color_min + c[1] * q->color_step,
+                  q->color_min + c[2] * q->color_step}};
+}
+
+static inline float
+quantize_decode_opacity(const gsmodel_quantized *q, size_t i) {
+  return q->colors[4 * i + 3] * (1.f / 255.f);
+}
+
+static inline vec3f
+quantize_decode_scale(const gsmodel_quantized *q, size_t i) {
+  const uint16_t *c = q->scales + 3 * i;
+  float s = 1.f / q->scale_mult;
+  return (vec3f){{quantize_half_to_float(c[0]) * s,
+                  quantize_half_to_float(c[1]) * s,
+                  quantize_half_to_float(c[2]) * s}};
+}
+
+static inline vec4f
+quantize_decode_rotation(const gsmodel_quantized *q, size_t i) {
+  uint32_t packed = q->rotations[i];
+  uint32_t largest = packed >> 30;
+
+  float c[3], sum = 0.f;
+  for (int j = 0; j < 3; ++j) {
+    uint32_t v = (packed >> (20 - 10 * j)) & 0x3FF;
+    c[j] = (v * (1.f / QUANTIZE_ROTATION_MAX) - 0.5f) * QUANTIZE_SQRT2;
+    sum += c[j] * c[j];
+  }
+
+  vec4f r;
+  for (uint32_t j = 0, k = 0; j < 4; ++j) {
+    r.v[j] = j == largest ? sqrtf(fmaxf(0.f, 1.f - sum)) : c[k++];
+  }
+  return r;
+}
+
+#endif
@@ -7,9 +7,24 @@
 #include "camera.h"
 #include "linalg.h"
 #include "loader.h"
+#include "scene.h"
 
 typedef struct raster_ctx_t raster_ctx;
 
+typedef enum {
+  RASTERIZER_SORT_DEPTH,       /* sort by depth, then bin into tiles */
+  RASTERIZER_SORT_TILE,        /* sort a (tile, depth) key per binned splat */
+  RASTERIZER_SORT_INCREMENTAL, /* depth sort starting from the last order */
+} rasterizer_sort_mode;
+
+/* memory of the tile-splat pairs */
+typedef struct {
+  size_t n_pairs;               /* binned in the last frame */
+  size_t n_pairs_peak;          /* most binned in any frame */
+  size_t visibility_bytes;      /* held for the pairs */
+  size_t visibility_bytes_peak; /* high-water mark of visibility_bytes */
+} rasterizer_stats;
+
 typedef struct {
   size_t width;
   size_t height;
@@ -24,6 +39,28 @@ void rasterizer_frame_clear(frame *frame);
 raster_ctx *rasterizer_context_create(gsmodel *model, frame *frame,
                                       vec2u tile_size);
 
+/* renders all instances of scene, which must outlive the context */
+raster_ctx *rasterizer_context_create_scene(gsscene *scene, frame *frame,
+                                            vec2u tile_size);
+
+void rasterizer_set_sort_mode(raster_ctx *ctx, rasterizer_sort_mode mode);
+
+/*
+ * Draws a merged splat instead of the points below a node of a model
+ * hierarchy, see gsmodel.lod, once the node spans less than pixels on screen.
+ * 0 draws all points.
+ */
+void rasterizer_set_lod_threshold(raster_ctx *ctx, float pixels);
+
+/*
+ * The buffers of the tile-splat pairs grow to the most pairs of a frame. They
+ * shrink once n_frames frames in a row used less than a quarter of them, 0
+ * keeps them at their peak.
+ */
+void rasterizer_set_shrink_frames(raster_ctx *ctx, size_t n_frames);
+
+rasterizer_stats rasterizer_get_stats(const raster_ctx *ctx);
+
 void rasterizer_preprocess(raster_ctx *ctx, camera *camera, frame *frame);
 
 void rasterizer_render(raster_ctx *ctx, camera *camera, frame *frame);
@@ -0,0 +1,57 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stddef.h>
+
+#include "linalg.h"
+#include "loader.h"
+
+/*
+ * Placement of a model in the world. transform maps model space to world
+ * space in the row vector convention of camera_get_view, i.e. the last row
+ * holds the translation. It must be affine.
+ */
+typedef struct {
+  size_t model; /* index into gsscene.models */
+  mat4 transform;
+} gsinstance;
+
+typedef struct {
+  gsmodel **models;
+  size_t n_models;
+  gsinstance *instances;
+  size_t n_instances;
+  int owns_models; /* destroy the models with the scene */
+} gsscene;
+
+gsscene *scene_create();
+
+/* returns the index of the model in the scene */
+size_t scene_add_model(gsscene *scene, gsmodel *model);
+
+void scene_add_instance(gsscene *scene, size_t model, mat4 transform);
+
+/* sum of the points of all instances */
+size_t scene_num_points(const gsscene *scene);
+
+/*
+ * Loads a JSON scene description:
+ *
+ *   {
+ *     "models": ["room.ply", "chair.splat"],
+ *     "instances": [
+ *       {"model": 0},
+ *       {"model": 1, "translation": [1, 0, 2], "rotation": [1, 0, 0, 0],
+ *        "scale": 0.5},
+ *       {"model": 1, "matrix": [16 numbers, row major]}
+ *     ]
+ *   }
+ *
+ * Model paths are relative to the scene file, rotations are quaternions
+ * (w, x, y, z) and scales a number or one number per axis.
+ */
+gsscene *scene_load(const char *fn, const loader_options *opts);
+
+void scene_destroy(gsscene *scene);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SH_H
+#define SH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "linalg.h"
+
+#define SH_MAX_DEGREE 3
+#define SH_BATCH_SIZE 8 /* splats evaluated together, one per SIMD lane */
+
+/* number of coefficients per color channel, excluding the DC term */
+size_t sh_num_coeffs(int degree);
+
+/* returns the degree for a number of f_rest_* coefficients, -1 if invalid */
+int sh_degree_from_rest(size_t n_rest);
+
+/*
+ * Adds the view-dependent SH bands to the base (DC) colors of the splats in
+ * idx and writes the clamped result to colors[idx[i]]. dirs[i] is the
+ * (unnormalized) direction from the camera to splat idx[i]. Coefficients are
+ * stored per splat as sh_num_coeffs(degree) rgb triplets.
+ */
+void sh_evaluate(int degree, const float *sh, const uint32_t *idx,
+                 const vec3f *dirs, size_t n, const vec3f *base_colors,
+                 vec3f *colors);
+
+/* same as sh_evaluate for half float coefficients */
+void sh_evaluate_f16(int degree, const uint16_t *sh, const uint32_t *idx,
+                     const vec3f *dirs, size_t n, const vec3f *base_colors,
+                     vec3f *colors);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "threadpool.h"
+
+#define SORT_RADIX_BITS 8
+#define SORT_MIN_CHUNK_SIZE (1 << 14) /* keys per thread, at least */
+
+/*
+ * Stable LSD radix sort of keys in ascending order, moving values along.
+ * tmp_keys and tmp_values hold n entries each, the result ends up in keys and
+ * values. Each pass builds one histogram per chunk on pool and scatters the
+ * chunks in parallel. Runs on the calling thread if pool is NULL.
+ */
+void sort_radix_u32(tpool *pool, uint32_t *keys, uint32_t *values,
+                    uint32_t *tmp_keys, uint32_t *tmp_values, size_t n);
+
+/* same for 64-bit keys, of which only the lowest key_bits are compared */
+void sort_radix_u64(tpool *pool, uint64_t *keys, uint32_t *values,
+                    uint64_t *tmp_keys, uint32_t *tmp_values, size_t n,
+                    int key_bits);
+
+/*
+ * Stable insertion sort for nearly sorted keys, O(n + inversions). Gives up
+ * and returns 0 once the first i keys needed more than about
+ * i * max_shifts_per_key moves, leaving a permutation of the input.
+ */
+int sort_insertion_u32(uint32_t *keys, uint32_t *values, size_t n,
+                       size_t max_shifts_per_key);
+
+/* stable merge of the sorted runs [0, n_first) and [n_first, n) into dst_* */
+void sort_merge_u32(const uint32_t *keys, const uint32_t *values,
+                    size_t n_first, size_t n, uint32_t *dst_keys,
+                    uint32_t *dst_values);
+
+/* key that sorts like the float f */
+static inline uint32_t
+sort_float_key(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits ^ ((bits & 0x80000000u) ? 0xffffffffu : 0x80000000u);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SPLATC_H
+#define SPLATC_H
+
+#include <stdint.h>
+
+/* on-disk layout of pre-baked .splatc files, all values little endian */
+
+#define SPLATC_MAGIC "SPLATC\0\0"
+#define SPLATC_VERSION 3
+#define SPLATC_ALIGNMENT 64
+#define SPLATC_MAX_SECTIONS 16
+
+typedef enum {
+  SPLATC_SECTION_POSITIONS,
+  SPLATC_SECTION_COLORS,
+  SPLATC_SECTION_OPACITIES,
+  SPLATC_SECTION_SCALES,
+  SPLATC_SECTION_ROTATIONS,
+  SPLATC_SECTION_SH,
+  SPLATC_SECTION_CHUNKS, /* optional, one splatc_chunk per chunk */
+  SPLATC_SECTION_COUNT
+} splatc_section_kind;
+
+/* one array, stored at a SPLATC_ALIGNMENT aligned file offset */
+typedef struct {
+  uint32_t kind;
+  uint32_t stride;
+  uint64_t offset;
+  uint64_t size;
+} splatc_section;
+
+/*
+ * Header of a pre-baked .splatc file. All arrays hold the fully activated
+ * model so that a cache can be mapped and rendered without any processing.
+ * The source size and modification time detect stale caches.
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t n_sections;
+  uint64_t n_points;
+  uint32_t sh_degree;
+  uint32_t reserved;
+  uint64_t source_size;
+  int64_t source_mtime;
+  float bounds_min[3];
+  float bounds_max[3];
+  splatc_section sections[SPLATC_MAX_SECTIONS];
+} splatc_header;
+
+/*
+ * Spatially coherent run of points [begin, begin + count) in a chunked file.
+ * The bounds enclose the point positions of the chunk.
+ */
+typedef struct {
+  float bounds_min[3];
+  float bounds_max[3];
+  uint64_t begin;
+  uint64_t count;
+} splatc_chunk;
+
+#endif
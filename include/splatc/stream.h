@@ -0,0 +1,46 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+
+#include "camera.h"
+#include "loader.h"
+
+#define STREAM_DEFAULT_CHUNK_SIZE (1 << 14) /* points per chunk when baking */
+
+typedef struct gsstream_t gsstream;
+
+/* cumulative paging statistics */
+typedef struct {
+  size_t n_requests; /* visible chunks looked up */
+  size_t n_hits;     /* ... that were already resident */
+  size_t n_loaded;   /* chunks paged in */
+  size_t n_evicted;  /* chunks paged out */
+  size_t n_dropped;  /* visible chunks that did not fit into the budget */
+  size_t bytes_read;
+  double read_time; /* seconds */
+} stream_stats;
+
+/*
+ * Opens a chunked .splatc file (see loader_gsmodel_write_splatc_chunked) for
+ * out-of-core rendering. At most budget bytes of point data are resident.
+ */
+gsstream *stream_open(const char *fn, size_t budget);
+
+/*
+ * The resident subset. Its arrays stay at the same addresses, but n_points
+ * and the order of the points change with every stream_update.
+ */
+gsmodel *stream_model(gsstream *stream);
+
+/*
+ * Pages in the chunks that intersect the view frustum of camera, nearest
+ * first, evicting the least recently visible chunks to stay in budget.
+ */
+void stream_update(gsstream *stream, camera *camera);
+
+stream_stats stream_get_stats(const gsstream *stream);
+
+void stream_close(gsstream *stream);
+
+#endif
@@ -11,6 +11,8 @@ struct tpool;
 typedef struct tpool tpool;
 
 typedef void (*thread_func_t)(void *arg);
+typedef void (*range_func_t)(void *arg, size_t chunk, size_t begin,
+                             size_t end);
 
 tpool *tpool_create(size_t num);
 void tpool_destroy(tpool *tm);
@@ -18,4 +20,12 @@ void tpool_destroy(tpool *tm);
 int tpool_add_work(tpool *tm, thread_func_t func, void *arg);
 void tpool_wait(tpool *tm);
 
+size_t tpool_num_threads(tpool *tm);
+
+/* splits [0, n) into n_chunks contiguous ranges and runs func on each of them,
+ * returns once all ranges are done. the calling thread runs ranges as well, so
+ * it may be a worker of tm. runs on the calling thread if tm is NULL */
+void tpool_parallel_for(tpool *tm, size_t n, size_t n_chunks, range_func_t func,
+                        void *arg);
+
 #endif
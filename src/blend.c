@@ -0,0 +1,191 @@
+#include <math.h>
+#include <splatc/blend.h>
+
+/*
+ * The scalar kernel walks the pixels a splat reaches one at a time and is the
+ * reference. The vector kernels are written as loops over the lanes of a
+ * batch of pixels, which the compiler vectorizes, and blend through masks
+ * instead of branches. Each instruction set gets its own copy of them.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLEND_X86
+#define BLEND_INLINE static inline __attribute__((always_inline))
+#define BLEND_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BLEND_INLINE static inline
+#endif
+
+#define N BLEND_BATCH_SIZE
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+BLEND_INLINE float
+fast_exp_neg(float x) {
+  return 1.f / (1.f + x + 0.48f * x * x);
+}
+
+/* pixels [x0, x1) x [y0, y1) of the tile within the extent of s */
+BLEND_INLINE int
+blend_splat_rect(const blend_tile *tile, const blend_splat *s, int *x0,
+                 int *x1, int *y0, int *y1) {
+  *x0 = MAX(tile->x0, (int)(s->mean.x - s->extent.x)) - tile->x0;
+  *x1 = MIN(tile->x0 + tile->width, (int)(s->mean.x + s->extent.x + 1)) -
+        tile->x0;
+  *y0 = MAX(tile->y0, (int)(s->mean.y - s->extent.y)) - tile->y0;
+  *y1 = MIN(tile->y0 + tile->height, (int)(s->mean.y + s->extent.y + 1)) -
+        tile->y0;
+  return *x0 < *x1 && *y0 < *y1;
+}
+
+static void
+blend_splats_scalar(blend_tile *tile, const blend_splat *splats,
+                    const uint32_t *visible, size_t n) {
+  float *T = tile->transmittance;
+  int n_live = tile->width * tile->height; /* pixels not saturated */
+
+  for (size_t z = 0; z < n && n_live > 0; ++z) {
+    const blend_splat *s = &splats[visible[z]];
+    int x0, x1, y0, y1;
+    if (!blend_splat_rect(tile, s, &x0, &x1, &y0, &y1)) continue;
+
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        int i = y * tile->stride + x;
+        if (T[i] < BLEND_MIN_TRANSMITTANCE) continue;
+
+        float dx = s->mean.x - (float)(tile->x0 + x);
+        float dy = s->mean.y - (float)(tile->y0 + y);
+        float power = -0.5f * (s->conic.x * dx * dx + s->conic.z * dy * dy) -
+                      s->conic.y * dx * dy;
+        if (power > 0.f) continue;
+        float alpha = fminf(BLEND_MAX_ALPHA, s->opacity * fast_exp_neg(-power));
+        if (alpha < tile->min_alpha) continue;
+
+        tile->color[0][i] += s->color.x * alpha * T[i];
+        tile->color[1][i] += s->color.y * alpha * T[i];
+        tile->color[2][i] += s->color.z * alpha * T[i];
+        T[i] *= 1.f - alpha;
+        n_live -= T[i] < BLEND_MIN_TRANSMITTANCE;
+      }
+    }
+  }
+}
+
+/* a splat as the lanes of a batch see it */
+typedef struct {
+  float mean_x, mean_y; /* in pixels */
+  float a, b, c;        /* conic */
+  float color[3];
+  float opacity;
+  float col0, col1; /* columns [col0, col1) of the tile it reaches */
+} blend_lanes_splat;
+
+/*
+ * Blends s into the N pixels at cols, rows, ..., of which lanes [lane0, lane1)
+ * are in its rows. Other lanes, lanes outside its columns, saturated pixels
+ * and pixels where s is too faint keep their color and transmittance. Returns
+ * the number of pixels s saturates.
+ */
+BLEND_INLINE int
+blend_batch_lanes(const blend_lanes_splat *s, int lane0, int lane1, float x0,
+                  float y0, float min_alpha, const float *restrict cols,
+                  const float *restrict rows, float *restrict R,
+                  float *restrict G, float *restrict B, float *restrict T) {
+  int n_saturated = 0;
+  for (int l = 0; l < N; ++l) {
+    float dx = s->mean_x - (x0 + cols[l]);
+    float dy = s->mean_y - (y0 + rows[l]);
+    float power = -0.5f * (s->a * dx * dx + s->c * dy * dy) - s->b * dx * dy;
+    float alpha = fminf(BLEND_MAX_ALPHA, s->opacity * fast_exp_neg(-power));
+    float t = T[l];
+    int blend = (l >= lane0) & (l < lane1) & (cols[l] >= s->col0) &
+                (cols[l] < s->col1) & (power <= 0.f) & (alpha >= min_alpha) &
+                (t >= BLEND_MIN_TRANSMITTANCE);
+    float a = blend ? alpha : 0.f;
+
+    R[l] += s->color[0] * a * t;
+    G[l] += s->color[1] * a * t;
+    B[l] += s->color[2] * a * t;
+    T[l] = t * (1.f - a);
+    n_saturated += blend & (T[l] < BLEND_MIN_TRANSMITTANCE);
+  }
+  return n_saturated;
+}
+
+/*
+ * Steps over the rows each splat reaches N pixels at a time. The steps are
+ * aligned to N, so that they stay within the arrays of the tile.
+ */
+BLEND_INLINE void
+blend_splats_lanes(blend_tile *tile, const blend_splat *splats,
+                   const uint32_t *visible, size_t n) {
+  const float x0 = (float)tile->x0;
+  const float y0 = (float)tile->y0;
+  int n_live = tile->width * tile->height; /* pixels not saturated */
+
+  for (size_t z = 0; z < n && n_live > 0; ++z) {
+    const blend_splat *s = &splats[visible[z]];
+    int c0, c1, r0, r1;
+    if (!blend_splat_rect(tile, s, &c0, &c1, &r0, &r1)) continue;
+
+    blend_lanes_splat ls = {s->mean.x,
+                            s->mean.y,
+                            s->conic.x,
+                            s->conic.y,
+                            s->conic.z,
+                            {s->color.x, s->color.y, s->color.z},
+                            s->opacity,
+                            (float)c0,
+                            (float)c1};
+    int begin = r0 * tile->stride;
+    int end = r1 * tile->stride;
+    for (int i = begin / N * N; i < end; i += N) {
+      n_live -= blend_batch_lanes(&ls, begin - i, end - i, x0, y0,
+                                  tile->min_alpha, tile->cols + i,
+                                  tile->rows + i, tile->color[0] + i,
+                                  tile->color[1] + i, tile->color[2] + i,
+                                  tile->transmittance + i);
+    }
+  }
+}
+
+#ifdef BLEND_X86
+BLEND_TARGET("sse4.1")
+static void
+blend_splats_sse4(blend_tile *tile, const blend_splat *splats,
+                  const uint32_t *visible, size_t n) {
+  blend_splats_lanes(tile, splats, visible, n);
+}
+
+BLEND_TARGET("avx2,fma")
+static void
+blend_splats_avx2(blend_tile *tile, const blend_splat *splats,
+                  const uint32_t *visible, size_t n) {
+  blend_splats_lanes(tile, splats, visible, n);
+}
+
+BLEND_TARGET("avx512f,fma,prefer-vector-width=512")
+static void
+blend_splats_avx512(blend_tile *tile, const blend_splat *splats,
+                    const uint32_t *visible, size_t n) {
+  blend_splats_lanes(tile, splats, visible, n);
+}
+#endif
+
+blend_kernels
+blend_get_kernels(cpu_isa isa) {
+#ifdef BLEND_X86
+  switch (isa) {
+    case CPU_ISA_AVX512:
+      return (blend_kernels){isa, blend_splats_avx512};
+    case CPU_ISA_AVX2:
+      return (blend_kernels){isa, blend_splats_avx2};
+    case CPU_ISA_SSE4:
+      return (blend_kernels){isa, blend_splats_sse4};
+    default:
+      break;
+  }
+#endif
+  (void)isa;
+  return (blend_kernels){CPU_ISA_SCALAR, blend_splats_scalar};
+}
@@ -0,0 +1,149 @@
+#include <math.h>
+#include <splatc/bvh.h>
+#include <splatc/quantize.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+  const gsmodel *model;
+  bvh_node *leaves;
+} bvh_leaf_args;
+
+/* bounds of the 3 sigma ellipsoids of the points of leaves [begin, end) */
+static void
+bvh_bound_leaves(void *arg, size_t chunk, size_t begin, size_t end) {
+  bvh_leaf_args *args = arg;
+  const gsmodel *model = args->model;
+  const gsmodel_quantized *q = model->quantized;
+  (void)chunk;
+
+  for (size_t leaf = begin; leaf < end; ++leaf) {
+    bvh_node *node = &args->leaves[leaf];
+    for (int k = 0; k < 3; ++k) {
+      node->min.v[k] = INFINITY;
+      node->max.v[k] = -INFINITY;
+    }
+
+    for (size_t i = node->begin; i < node->begin + node->count; ++i) {
+      vec3f p = q ? quantize_decode_position(q, i) : model->positions[i];
+      vec3f s = q ? quantize_decode_scale(q, i) : model->scales[i];
+      vec4f r = q ? quantize_decode_rotation(q, i) : model->rotations[i];
+
+      /* the covariance is R S S^T R^T, its diagonal gives the extents */
+      mat3 R = quat_to_mat3(r);
+      for (int k = 0; k < 3; ++k) {
+        float var = 0.f;
+        for (int j = 0; j < 3; ++j) {
+          float m = R.vv[k][j] * s.v[j];
+          var += m * m;
+        }
+        float extent = 3.f * sqrtf(var);
+        node->min.v[k] = fminf(node->min.v[k], p.v[k] - extent);
+        node->max.v[k] = fmaxf(node->max.v[k], p.v[k] + extent);
+      }
+    }
+  }
+}
+
+/* builds the subtree over leaves [begin, end) in bvh->nodes[index] */
+static void
+bvh_link(gsbvh *bvh, uint32_t index, const bvh_node *leaves, size_t begin,
+         size_t end) {
+  bvh_node *node = &bvh->nodes[index];
+  if (end - begin == 1) {
+    *node = leaves[begin];
+    return;
+  }
+
+  uint32_t left = bvh->n_nodes;
+  bvh->n_nodes += 2;
+  size_t mid = begin + (end - begin) / 2;
+  bvh_link(bvh, left, leaves, begin, mid);
+  bvh_link(bvh, left + 1, leaves, mid, end);
+
+  const bvh_node *a = &bvh->nodes[left];
+  const bvh_node *b = &bvh->nodes[left + 1];
+  for (int k = 0; k < 3; ++k) {
+    node->min.v[k] = fminf(a->min.v[k], b->min.v[k]);
+    node->max.v[k] = fmaxf(a->max.v[k], b->max.v[k]);
+  }
+  node->begin = a->begin;
+  node->count = a->count + b->count;
+  node->left = left;
+}
+
+gsbvh *
+bvh_build(const gsmodel *model, tpool *pool) {
+  size_t n = model->n_points;
+  if (n == 0 || (uint64_t)n > UINT32_MAX) return NULL;
+
+  size_t n_leaves = (n + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE;
+  gsbvh *bvh = calloc(1, sizeof(gsbvh));
+  bvh_node *leaves = calloc(n_leaves, sizeof(bvh_node));
+  if (bvh) bvh->nodes = calloc(2 * n_leaves - 1, sizeof(bvh_node));
+  if (!bvh || !leaves || !bvh->nodes) {
+    printf("[bvh] unable to allocate %zu leaves\n", n_leaves);
+    free(leaves);
+    bvh_destroy(bvh);
+    return NULL;
+  }
+
+  for (size_t leaf = 0; leaf < n_leaves; ++leaf) {
+    leaves[leaf].begin = leaf * BVH_LEAF_SIZE;
+    leaves[leaf].count =
+        leaf + 1 < n_leaves ? BVH_LEAF_SIZE : n - leaf * BVH_LEAF_SIZE;
+  }
+  bvh_leaf_args args = {model, leaves};
+  size_t n_chunks = pool ? tpool_num_threads(pool) : 1;
+  tpool_parallel_for(pool, n_leaves, n_chunks, bvh_bound_leaves, &args);
+
+  bvh->n_nodes = 1;
+  bvh->n_points = n;
+  bvh_link(bvh, 0, leaves, 0, n_leaves);
+  free(leaves);
+
+  printf("[bvh] built %zu nodes over %zu points\n", bvh->n_nodes, n);
+  return bvh;
+}
+
+void
+bvh_destroy(gsbvh *bvh) {
+  if (!bvh) return;
+  free(bvh->nodes);
+  free(bvh);
+}
+
+void
+bvh_box_to_view(vec3f min, vec3f max, const mat4 *model_view, vec3f *center,
+                vec3f *extent) {
+  const float(*M)[4] = model_view->vv;
+  for (int k = 0; k < 3; ++k) {
+    center->v[k] = M[3][k];
+    extent->v[k] = 0.f;
+    for (int j = 0; j < 3; ++j) {
+      float c = 0.5f * (min.v[j] + max.v[j]);
+      float e = 0.5f * (max.v[j] - min.v[j]);
+      center->v[k] += c * M[j][k];
+      extent->v[k] += e * fabsf(M[j][k]);
+    }
+  }
+}
+
+int
+bvh_view_box_visible(vec3f c, vec3f e, const bvh_frustum *frustum) {
+  /* outside if the box is entirely beyond one of the planes */
+  if (c.z + e.z < frustum->near || c.z - e.z > frustum->far) return 0;
+  if (fabsf(c.x) - frustum->tan_fovx * c.z > e.x + frustum->tan_fovx * e.z)
+    return 0;
+  if (fabsf(c.y) - frustum->tan_fovy * c.z > e.y + frustum->tan_fovy * e.z)
+    return 0;
+  return 1;
+}
+
+int
+bvh_node_visible(const bvh_node *node, const mat4 *model_view,
+                 const bvh_frustum *frustum) {
+  vec3f c, e;
+  bvh_box_to_view(node->min, node->max, model_view, &c, &e);
+  return bvh_view_box_visible(c, e, frustum);
+}
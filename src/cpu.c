@@ -0,0 +1,33 @@
+#include <splatc/cpu.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *CPU_ISA_NAMES[] = {"scalar", "sse4", "avx2", "avx512"};
+
+static cpu_isa
+cpu_supported_isa() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return CPU_ISA_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return CPU_ISA_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) return CPU_ISA_SSE4;
+#endif
+  return CPU_ISA_SCALAR;
+}
+
+cpu_isa
+cpu_detect_isa() {
+  cpu_isa isa = cpu_supported_isa();
+  const char *cap = getenv("SPLATC_ISA");
+  for (int i = 0; cap && i < (int)isa; ++i) {
+    if (strcmp(cap, CPU_ISA_NAMES[i]) == 0) return (cpu_isa)i;
+  }
+  return isa;
+}
+
+const char *
+cpu_isa_name(cpu_isa isa) {
+  return CPU_ISA_NAMES[isa];
+}
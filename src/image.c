@@ -0,0 +1,78 @@
+#include <png.h>
+#include <splatc/image.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SPLATC_WITH_WEBP
+#include <webp/decode.h>
+#endif
+
+static int
+has_extension(const char* fn, const char* ext) {
+  size_t len = strlen(fn);
+  size_t ext_len = strlen(ext);
+  return len >= ext_len && strcmp(fn + len - ext_len, ext) == 0;
+}
+
+static uint8_t*
+image_read_png(const char* fn, size_t* width, size_t* height) {
+  png_image image;
+  memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+
+  if (!png_image_begin_read_from_file(&image, fn)) return NULL;
+
+  image.format = PNG_FORMAT_RGBA;
+  uint8_t* pixels = malloc(PNG_IMAGE_SIZE(image));
+  if (!png_image_finish_read(&image, NULL, pixels, 0, NULL)) {
+    png_image_free(&image);
+    free(pixels);
+    return NULL;
+  }
+
+  *width = image.width;
+  *height = image.height;
+  return pixels;
+}
+
+#ifdef SPLATC_WITH_WEBP
+static uint8_t*
+image_read_webp(const char* fn, size_t* width, size_t* height) {
+  FILE* f = fopen(fn, "rb");
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t* data = len > 0 ? malloc(len) : NULL;
+  size_t n = data ? fread(data, 1, len, f) : 0;
+  fclose(f);
+
+  int w, h;
+  uint8_t* decoded = n ? WebPDecodeRGBA(data, n, &w, &h) : NULL;
+  free(data);
+  if (!decoded) return NULL;
+
+  /* hand out memory that can be released with free() */
+  uint8_t* pixels = malloc((size_t)w * h * 4);
+  memcpy(pixels, decoded, (size_t)w * h * 4);
+  WebPFree(decoded);
+
+  *width = w;
+  *height = h;
+  return pixels;
+}
+#endif
+
+uint8_t*
+image_read_rgba(const char* fn, size_t* width, size_t* height) {
+  if (has_extension(fn, ".webp")) {
+#ifdef SPLATC_WITH_WEBP
+    return image_read_webp(fn, width, height);
+#else
+    printf("[image] %s: built without WebP support\n", fn);
+    return NULL;
+#endif
+  }
+  return image_read_png(fn, width, height);
+}
@@ -0,0 +1,299 @@
+#include <splatc/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+  const char *text;
+  size_t len;
+  size_t pos;
+  int depth;
+} json_parser;
+
+static int json_parse_value(json_parser *p, json_value *out);
+
+static void
+json_skip_whitespace(json_parser *p) {
+  while (p->pos < p->len) {
+    char c = p->text[p->pos];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+    p->pos++;
+  }
+}
+
+static int
+json_expect(json_parser *p, const char *literal) {
+  size_t n = strlen(literal);
+  if (p->pos + n > p->len || strncmp(p->text + p->pos, literal, n) != 0)
+    return 0;
+  p->pos += n;
+  return 1;
+}
+
+static void
+json_free_children(json_value *value) {
+  for (size_t i = 0; i < value->n_children; ++i) {
+    json_free_children(&value->children[i]);
+    if (value->keys) free(value->keys[i]);
+  }
+  free(value->children);
+  free(value->keys);
+  free(value->string);
+}
+
+static size_t
+json_encode_utf8(unsigned int cp, char *out) {
+  if (cp < 0x80) {
+    out[0] = (char)cp;
+    return 1;
+  } else if (cp < 0x800) {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  out[0] = (char)(0xE0 | (cp >> 12));
+  out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[2] = (char)(0x80 | (cp & 0x3F));
+  return 3;
+}
+
+static char *
+json_parse_string(json_parser *p) {
+  if (p->pos >= p->len || p->text[p->pos] != '"') return NULL;
+  p->pos++;
+
+  /* escapes never grow the string, so the raw length is an upper bound */
+  size_t end = p->pos;
+  while (end < p->len && p->text[end] != '"') {
+    if (p->text[end] == '\\') end++;
+    end++;
+  }
+  if (end >= p->len) return NULL;
+
+  char *str = malloc(end - p->pos + 1);
+  size_t n = 0;
+  while (p->pos < end) {
+    char c = p->text[p->pos++];
+    if (c != '\\') {
+      str[n++] = c;
+      continue;
+    }
+
+    c = p->text[p->pos++];
+    switch (c) {
+      case 'b':
+        str[n++] = '\b';
+        break;
+      case 'f':
+        str[n++] = '\f';
+        break;
+      case 'n':
+        str[n++] = '\n';
+        break;
+      case 'r':
+        str[n++] = '\r';
+        break;
+      case 't':
+        str[n++] = '\t';
+        break;
+      case 'u': {
+        unsigned int cp = 0;
+        if (p->pos + 4 > end || sscanf(p->text + p->pos, "%4x", &cp) != 1) {
+          free(str);
+          return NULL;
+        }
+        p->pos += 4;
+        n += json_encode_utf8(cp, str + n);
+        break;
+      }
+      default:
+        str[n++] = c;
+        break;
+    }
+  }
+  str[n] = '\0';
+  p->pos = end + 1;
+  return str;
+}
+
+static int
+json_parse_number(json_parser *p, json_value *out) {
+  char buf[64];
+  size_t n = 0;
+  while (p->pos + n < p->len && n < sizeof(buf) - 1 &&
+         strchr("+-0123456789.eE", p->text[p->pos + n])) {
+    buf[n] = p->text[p->pos + n];
+    n++;
+  }
+  buf[n] = '\0';
+
+  char *end;
+  out->type = JSON_NUMBER;
+  out->number = strtod(buf, &end);
+  if (end == buf) return 0;
+  p->pos += end - buf;
+  return 1;
+}
+
+/* parses comma separated elements (or members if keyed) up to the close char */
+static int
+json_parse_children(json_parser *p, json_value *out, char close, int keyed) {
+  size_t capacity = 0;
+  p->pos++;
+
+  json_skip_whitespace(p);
+  if (p->pos < p->len && p->text[p->pos] == close) {
+    p->pos++;
+    return 1;
+  }
+
+  while (p->pos < p->len) {
+    if (out->n_children == capacity) {
+      capacity = capacity ? 2 * capacity : 8;
+      out->children = realloc(out->children, capacity * sizeof(json_value));
+      if (keyed) out->keys = realloc(out->keys, capacity * sizeof(char *));
+    }
+
+    json_value *child = &out->children[out->n_children];
+    memset(child, 0, sizeof(json_value));
+
+    json_skip_whitespace(p);
+    if (keyed) {
+      char *key = json_parse_string(p);
+      if (!key) return 0;
+      json_skip_whitespace(p);
+      if (p->pos >= p->len || p->text[p->pos] != ':') {
+        free(key);
+        return 0;
+      }
+      p->pos++;
+      out->keys[out->n_children] = key;
+    }
+
+    /* count the child before parsing it so that failures clean it up */
+    out->n_children++;
+    if (!json_parse_value(p, child)) return 0;
+
+    json_skip_whitespace(p);
+    if (p->pos >= p->len) return 0;
+    if (p->text[p->pos] == ',') {
+      p->pos++;
+    } else if (p->text[p->pos] == close) {
+      p->pos++;
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+static int
+json_parse_value(json_parser *p, json_value *out) {
+  json_skip_whitespace(p);
+  if (p->pos >= p->len) return 0;
+
+  int ok = 0;
+  char c = p->text[p->pos];
+  if (c == '{' || c == '[') {
+    if (++p->depth > JSON_MAX_DEPTH) return 0;
+    out->type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+    ok = json_parse_children(p, out, c == '{' ? '}' : ']', c == '{');
+    p->depth--;
+  } else if (c == '"') {
+    out->type = JSON_STRING;
+    out->string = json_parse_string(p);
+    ok = out->string != NULL;
+  } else if (json_expect(p, "true")) {
+    out->type = JSON_BOOL;
+    out->number = 1.0;
+    ok = 1;
+  } else if (json_expect(p, "false")) {
+    out->type = JSON_BOOL;
+    ok = 1;
+  } else if (json_expect(p, "null")) {
+    out->type = JSON_NULL;
+    ok = 1;
+  } else {
+    ok = json_parse_number(p, out);
+  }
+  return ok;
+}
+
+json_value *
+json_parse(const char *text, size_t len) {
+  json_parser p = {text, len, 0, 0};
+  json_value *value = calloc(1, sizeof(json_value));
+
+  if (!json_parse_value(&p, value)) {
+    json_destroy(value);
+    return NULL;
+  }
+  return value;
+}
+
+json_value *
+json_parse_file(const char *fn) {
+  FILE *f = fopen(fn, "rb");
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (len <= 0) {
+    fclose(f);
+    return NULL;
+  }
+
+  char *text = malloc(len);
+  size_t n = fread(text, 1, len, f);
+  fclose(f);
+
+  json_value *value = json_parse(text, n);
+  free(text);
+  return value;
+}
+
+const json_value *
+json_get(const json_value *object, const char *key) {
+  if (!object || object->type != JSON_OBJECT) return NULL;
+  for (size_t i = 0; i < object->n_children; ++i) {
+    if (strcmp(object->keys[i], key) == 0) return &object->children[i];
+  }
+  return NULL;
+}
+
+const json_value *
+json_at(const json_value *array, size_t i) {
+  if (!array || array->type != JSON_ARRAY || i >= array->n_children)
+    return NULL;
+  return &array->children[i];
+}
+
+size_t
+json_length(const json_value *value) {
+  if (!value) return 0;
+  return value->n_children;
+}
+
+double
+json_number(const json_value *value, double fallback) {
+  if (!value || (value->type != JSON_NUMBER && value->type != JSON_BOOL))
+    return fallback;
+  return value->number;
+}
+
+const char *
+json_string(const json_value *value) {
+  if (!value || value->type != JSON_STRING) return NULL;
+  return value->string;
+}
+
+void
+json_destroy(json_value *value) {
+  if (!value) return;
+  json_free_children(value);
+  free(value);
+}
@@ -162,3 +162,36 @@ transpose4(mat4 m) {
   }
   return t;
 }
+
+mat3
+inverse3(mat3 m) {
+  mat3 adj = {{m.vv[1][1] * m.vv[2][2] - m.vv[1][2] * m.vv[2][1],
+               m.vv[0][2] * m.vv[2][1] - m.vv[0][1] * m.vv[2][2],
+               m.vv[0][1] * m.vv[1][2] - m.vv[0][2] * m.vv[1][1],
+               m.vv[1][2] * m.vv[2][0] - m.vv[1][0] * m.vv[2][2],
+               m.vv[0][0] * m.vv[2][2] - m.vv[0][2] * m.vv[2][0],
+               m.vv[0][2] * m.vv[1][0] - m.vv[0][0] * m.vv[1][2],
+               m.vv[1][0] * m.vv[2][1] - m.vv[1][1] * m.vv[2][0],
+               m.vv[0][1] * m.vv[2][0] - m.vv[0][0] * m.vv[2][1],
+               m.vv[0][0] * m.vv[1][1] - m.vv[0][1] * m.vv[1][0]}};
+  float det = m.vv[0][0] * adj.vv[0][0] + m.vv[0][1] * adj.vv[1][0] +
+              m.vv[0][2] * adj.vv[2][0];
+  float rdet = det != 0.f ? 1.f / det : 0.f;
+  for (int i = 0; i < 9; ++i) adj.v[i] *= rdet;
+  return adj;
+}
+
+mat3
+quat_to_mat3(vec4f q) {
+  float r = q.x;
+  float x = q.y;
+  float y = q.z;
+  float z = q.w;
+
+  mat3 R = {{1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z),
+             2.f * (x * z + r * y),       2.f * (x * y + r * z),
+             1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x),
+             2.f * (x * z - r * y),       2.f * (y * z + r * x),
+             1.f - 2.f * (x * x + y * y)}};
+  return R;
+}
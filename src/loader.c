@@ -1,11 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <fcntl.h>
 #include <math.h>
+#include <pthread.h>
 #include <rply.h>
+#include <splatc/bvh.h>
+#include <splatc/image.h>
+#include <splatc/json.h>
 #include <splatc/loader.h>
+#include <splatc/lod.h>
+#include <splatc/quantize.h>
+#include <splatc/sh.h>
+#include <splatc/sort.h>
+#include <splatc/splatc.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define C0 0.28209
+#define SQRT2 1.41421356f
+
+#define LOADER_CHUNK_SIZE (1 << 16) /* points decoded per worker task */
+#define LOADER_PROGRESS_BATCH (1 << 18) /* points per progress report */
+#define LOADER_PAGE_SIZE 4096
+#define LOADER_MORTON_BITS 10 /* per axis, codes fit into 32 bits */
+
+#define PLY_MAX_HEADER_SIZE (1 << 16)
+#define PLY_MAX_REST 45 /* f_rest_* properties of a degree 3 model */
+#define PLY_REST_DIM 100 /* rply callback index of f_rest_0 */
+
+#define SPLATC_WRITE_BLOCK 4096 /* points gathered per write when reordering */
+
+#define SOGS_MAX_PATH 4096
+#define SOGS_CODEBOOK_SIZE 256
+
+typedef enum {
+  PLY_ATTR_X,
+  PLY_ATTR_Y,
+  PLY_ATTR_Z,
+  PLY_ATTR_DC_0,
+  PLY_ATTR_DC_1,
+  PLY_ATTR_DC_2,
+  PLY_ATTR_SCALE_0,
+  PLY_ATTR_SCALE_1,
+  PLY_ATTR_SCALE_2,
+  PLY_ATTR_ROT_0,
+  PLY_ATTR_ROT_1,
+  PLY_ATTR_ROT_2,
+  PLY_ATTR_ROT_3,
+  PLY_ATTR_OPACITY,
+  PLY_ATTR_COUNT
+} ply_attribute;
+
+/* property names in the same order as ply_attribute */
+static const char* ply_attribute_names[PLY_ATTR_COUNT] = {
+    "x",       "y",       "z",     "f_dc_0", "f_dc_1", "f_dc_2",  "scale_0",
+    "scale_1", "scale_2", "rot_0", "rot_1",  "rot_2",  "rot_3",   "opacity"};
+
+/* byte layout of a binary vertex record, derived from the PLY header */
+typedef struct {
+  long n_vertices;
+  size_t data_offset;
+  size_t stride;
+  size_t offsets[PLY_ATTR_COUNT];
+  int sh_degree;
+  size_t rest_offsets[PLY_MAX_REST];
+} ply_layout;
+
+typedef struct {
+  const ply_layout* layout;
+  const uint8_t* records;
+  gsmodel* model;
+  size_t first; /* record the decoded batch starts at */
+} ply_decode_args;
+
+/* antimatter15 .splat record, 32 bytes per point */
+typedef struct {
+  float position[3];
+  float scale[3];
+  uint8_t color[4];    /* rgb and activated opacity */
+  uint8_t rotation[4]; /* quaternion (w, x, y, z), mapped to [0, 255] */
+} splat_record;
+
+typedef struct {
+  const splat_record* records;
+  gsmodel* model;
+} splat_decode_args;
+
+typedef enum {
+  SOGS_MEANS_L,
+  SOGS_MEANS_U,
+  SOGS_SCALES,
+  SOGS_QUATS,
+  SOGS_SH0,
+  SOGS_SH_CENTROIDS, /* optional, higher SH bands */
+  SOGS_SH_LABELS,
+  SOGS_IMAGE_COUNT
+} sogs_image;
+
+#define SOGS_SH_CENTROIDS_PER_ROW 64
+
+typedef struct {
+  char path[SOGS_MAX_PATH];
+  uint8_t* pixels;
+  size_t width;
+  size_t height;
+} sogs_image_file;
+
+/*
+ * Decoded SOGS bundle. Version 1 stores scales and sh0 as linear ranges per
+ * channel, version 2 (SOG) maps every byte through a shared codebook.
+ */
+typedef struct {
+  int version;
+  sogs_image_file images[SOGS_IMAGE_COUNT];
+  float means_min[3];
+  float means_max[3];
+  float scales_min[3];
+  float scales_max[3];
+  float sh0_min[4];
+  float sh0_max[4];
+  float scales_codebook[SOGS_CODEBOOK_SIZE];
+  float sh0_codebook[SOGS_CODEBOOK_SIZE];
+  float shn_min;
+  float shn_max;
+  float shn_codebook[SOGS_CODEBOOK_SIZE];
+  gsmodel* model;
+} sogs_bundle;
 
 typedef struct {
   gsmodel* model;
@@ -14,9 +140,7 @@ typedef struct {
   size_t scales_read;
   size_t rotations_read;
   size_t opacities_read;
-
-  vec3f* scales;
-  vec4f* rotations;
+  size_t rest_read;
 
 } ply_read_payload;
 
@@ -43,31 +167,46 @@ loader_nomalize_positions(gsmodel* model) {
   }
 }
 
+/* Rotations are stored unnormalized in most files. */
 static void
-loader_compute_cov3d(ply_read_payload* payload, gsmodel* model) {
-  for (size_t i = 0; i < model->n_points; ++i) {
-    mat3 S = mat3_id();
-    S.vv[0][0] = payload->scales[i].x;
-    S.vv[1][1] = payload->scales[i].y;
-    S.vv[2][2] = payload->scales[i].z;
+loader_normalize_rotations(vec4f* rotations, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    vec4f q = rotations[i];
+    float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    float rlen = len > 0.f ? 1.f / len : 0.f;
+    rotations[i] = (vec4f){{q.x * rlen, q.y * rlen, q.z * rlen, q.w * rlen}};
+    if (len == 0.f) rotations[i].x = 1.f;
+  }
+}
 
-    vec4f q = payload->rotations[i];
-    float r = q.x;
-    float x = q.y;
-    float y = q.z;
-    float z = q.w;
+static void
+loader_normalize_rotations_chunk(void* arg, size_t chunk, size_t begin,
+                                 size_t end) {
+  gsmodel* model = arg;
+  (void)chunk;
+  loader_normalize_rotations(model->rotations + begin, end - begin);
+}
 
-    mat3 R = {1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z),
-              2.f * (x * z + r * y),       2.f * (x * y + r * z),
-              1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x),
-              2.f * (x * z - r * y),       2.f * (y * z + r * x),
-              1.f - 2.f * (x * x + y * y)};
+static size_t
+loader_num_chunks(size_t n) {
+  return (n + LOADER_CHUNK_SIZE - 1) / LOADER_CHUNK_SIZE;
+}
 
-    mat3 M = matmul3(R, S);
-    mat3 sigma = matmul3(M, transpose3(M));
+/* Returns the pool to decode on, creating a temporary one if requested. */
+static tpool*
+loader_acquire_pool(const loader_options* opts, int* owned) {
+  *owned = 0;
+  if (!opts) return NULL;
+  if (opts->pool) return opts->pool;
+  if (opts->n_threads <= 1) return NULL;
 
-    model->cov3d[i] = sigma;
-  }
+  *owned = 1;
+  return tpool_create(opts->n_threads);
+}
+
+static void
+loader_release_pool(tpool* pool, int owned) {
+  if (owned) tpool_destroy(pool);
 }
 
 static int
@@ -82,12 +221,19 @@ loader_ply_read_callback(p_ply_argument arg) {
 
   double v = ply_get_argument_value(arg);
 
-  if (dim > 12) { /* opacity */
+  if (dim >= PLY_REST_DIM) { /* higher SH bands, stored channel-major */
+    if (model->sh_degree == 0) return 1;
+    size_t n_coeffs = sh_num_coeffs(model->sh_degree);
+    size_t rest = dim - PLY_REST_DIM;
+    size_t point = payload->rest_read++ / (3 * n_coeffs);
+    model->sh[(point * n_coeffs + rest % n_coeffs) * 3 + rest / n_coeffs] =
+        (float)v;
+  } else if (dim > 12) { /* opacity */
     model->opacities[payload->opacities_read++] = 1.f / (1.f + expf(-(float)v));
   } else if (dim > 8) { /* rotation */
-    payload->rotations[payload->rotations_read++ / 4].v[dim - 9] = (float)v;
+    model->rotations[payload->rotations_read++ / 4].v[dim - 9] = (float)v;
   } else if (dim > 5) { /* scale */
-    payload->scales[payload->scales_read++ / 3].v[dim - 6] = expf((float)v);
+    model->scales[payload->scales_read++ / 3].v[dim - 6] = expf((float)v);
   } else if (dim > 2) { /* color */
     model->colors[payload->colors_read++ / 3].v[dim - 3] = (float)v * C0 + 0.5f;
   } else { /* position */
@@ -97,6 +243,322 @@ loader_ply_read_callback(p_ply_argument arg) {
   return 1;
 }
 
+static const uint8_t*
+loader_map_file(const char* fn, size_t* size) {
+  int fd = open(fn, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  *size = st.st_size;
+  return data;
+}
+
+static void
+loader_unmap_file(const uint8_t* data, size_t size) {
+  munmap((void*)data, size);
+}
+
+static int
+loader_host_is_little_endian() {
+  const uint32_t probe = 1;
+  return *(const uint8_t*)&probe == 1;
+}
+
+/* Returns the size of a PLY scalar type in bytes, 0 for unknown types. */
+static size_t
+loader_ply_type_size(const char* type) {
+  static const char* types[] = {"char",  "int8",    "uchar",  "uint8",
+                                "short", "int16",   "ushort", "uint16",
+                                "int",   "int32",   "uint",   "uint32",
+                                "float", "float32", "double", "float64"};
+  static const size_t sizes[] = {1, 1, 1, 1, 2, 2, 2, 2,
+                                 4, 4, 4, 4, 4, 4, 8, 8};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    if (strcmp(type, types[i]) == 0) return sizes[i];
+  }
+  return 0;
+}
+
+/*
+ * Parses the header of a binary_little_endian PLY file and computes the byte
+ * offset of every gaussian attribute inside a vertex record. Returns 0 if the
+ * file uses a layout the fast path does not handle (ASCII, big endian, list
+ * properties, non-float attributes, elements preceding the vertices), in which
+ * case the caller falls back to rply.
+ */
+static int
+loader_ply_parse_layout(const uint8_t* data, size_t size, ply_layout* layout) {
+  size_t header_size = size < PLY_MAX_HEADER_SIZE ? size : PLY_MAX_HEADER_SIZE;
+  char line[256];
+  size_t pos = 0;
+  int in_vertex = 0, seen_vertex = 0, seen_format = 0;
+
+  memset(layout, 0, sizeof(ply_layout));
+  int found[PLY_ATTR_COUNT] = {0};
+  int found_rest[PLY_MAX_REST] = {0};
+
+  while (pos < header_size) {
+    size_t len = 0;
+    while (pos + len < header_size && data[pos + len] != '\n') len++;
+    if (pos + len >= header_size) return 0;
+
+    size_t n = len < sizeof(line) - 1 ? len : sizeof(line) - 1;
+    memcpy(line, data + pos, n);
+    line[n] = '\0';
+    if (n > 0 && line[n - 1] == '\r') line[n - 1] = '\0';
+    pos += len + 1;
+
+    char kw[32], a[64], b[64];
+    int n_tokens = sscanf(line, "%31s %63s %63s", kw, a, b);
+    if (n_tokens < 1) continue;
+
+    if (strcmp(kw, "ply") == 0 || strcmp(kw, "comment") == 0 ||
+        strcmp(kw, "obj_info") == 0) {
+      continue;
+    } else if (strcmp(kw, "format") == 0) {
+      if (n_tokens < 2 || strcmp(a, "binary_little_endian") != 0) return 0;
+      seen_format = 1;
+    } else if (strcmp(kw, "element") == 0) {
+      if (n_tokens < 3) return 0;
+      if (strcmp(a, "vertex") == 0) {
+        /* other elements before the vertices would shift the data offset */
+        if (seen_vertex) return 0;
+        layout->n_vertices = atol(b);
+        in_vertex = seen_vertex = 1;
+      } else {
+        if (!seen_vertex) return 0;
+        in_vertex = 0;
+      }
+    } else if (strcmp(kw, "property") == 0) {
+      if (!in_vertex) continue;
+      if (n_tokens < 3 || strcmp(a, "list") == 0) return 0;
+
+      size_t type_size = loader_ply_type_size(a);
+      if (type_size == 0) return 0;
+
+      int is_float = strcmp(a, "float") == 0 || strcmp(a, "float32") == 0;
+      for (int i = 0; i < PLY_ATTR_COUNT; ++i) {
+        if (strcmp(b, ply_attribute_names[i]) != 0) continue;
+        if (!is_float) return 0;
+        layout->offsets[i] = layout->stride;
+        found[i] = 1;
+      }
+      if (strncmp(b, "f_rest_", 7) == 0) {
+        int rest = atoi(b + 7);
+        if (!is_float || rest < 0 || rest >= PLY_MAX_REST) return 0;
+        layout->rest_offsets[rest] = layout->stride;
+        found_rest[rest] = 1;
+      }
+      layout->stride += type_size;
+    } else if (strcmp(kw, "end_header") == 0) {
+      layout->data_offset = pos;
+      break;
+    } else {
+      return 0;
+    }
+  }
+
+  if (!seen_format || !seen_vertex || layout->data_offset == 0) return 0;
+  for (int i = 0; i < PLY_ATTR_COUNT; ++i) {
+    if (!found[i]) return 0;
+  }
+
+  /* SH bands are only used if all coefficients of a degree are present */
+  size_t n_rest = 0;
+  while (n_rest < PLY_MAX_REST && found_rest[n_rest]) n_rest++;
+  layout->sh_degree = sh_degree_from_rest(n_rest);
+  if (layout->sh_degree < 0) layout->sh_degree = 0;
+
+  return 1;
+}
+
+/* Copies one float attribute out of an array of strided vertex records. */
+static void
+loader_ply_gather(const uint8_t* records, size_t stride, size_t offset,
+                  size_t n, float* dst, size_t dst_stride) {
+  const uint8_t* src = records + offset;
+  for (size_t i = 0; i < n; ++i) {
+    memcpy(dst + i * dst_stride, src + i * stride, sizeof(float));
+  }
+}
+
+/*
+ * Decodes vertex records [begin, end) into the model arrays, applying the same
+ * activations as the rply path.
+ */
+static void
+loader_ply_decode_chunk(void* arg, size_t chunk, size_t begin, size_t end) {
+  ply_decode_args* args = arg;
+  begin += args->first;
+  end += args->first;
+  const ply_layout* layout = args->layout;
+  gsmodel* model = args->model;
+  const uint8_t* base = args->records + begin * layout->stride;
+  const size_t stride = layout->stride;
+  const size_t n = end - begin;
+  (void)chunk;
+
+  for (int j = 0; j < 3; ++j) {
+    loader_ply_gather(base, stride, layout->offsets[PLY_ATTR_X + j], n,
+                      &model->positions[begin].v[j], 3);
+    loader_ply_gather(base, stride, layout->offsets[PLY_ATTR_DC_0 + j], n,
+                      &model->colors[begin].v[j], 3);
+    loader_ply_gather(base, stride, layout->offsets[PLY_ATTR_SCALE_0 + j], n,
+                      &model->scales[begin].v[j], 3);
+  }
+  for (int j = 0; j < 4; ++j) {
+    loader_ply_gather(base, stride, layout->offsets[PLY_ATTR_ROT_0 + j], n,
+                      &model->rotations[begin].v[j], 4);
+  }
+  loader_ply_gather(base, stride, layout->offsets[PLY_ATTR_OPACITY], n,
+                    &model->opacities[begin], 1);
+
+  /* f_rest_* is channel-major, the model interleaves rgb per coefficient */
+  size_t n_coeffs = sh_num_coeffs(model->sh_degree);
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t k = 0; k < n_coeffs; ++k) {
+      loader_ply_gather(base, stride, layout->rest_offsets[c * n_coeffs + k],
+                        n, &model->sh[(begin * n_coeffs + k) * 3 + c],
+                        3 * n_coeffs);
+    }
+  }
+
+  for (size_t i = begin; i < end; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      model->colors[i].v[j] = model->colors[i].v[j] * C0 + 0.5f;
+      model->scales[i].v[j] = expf(model->scales[i].v[j]);
+    }
+    model->opacities[i] = 1.f / (1.f + expf(-model->opacities[i]));
+  }
+  loader_normalize_rotations(model->rotations + begin, n);
+}
+
+/*
+ * Fast path for binary_little_endian files: maps the file and decodes the
+ * vertex records in place, bypassing the per-scalar rply callbacks. Returns
+ * NULL if the file layout is not supported so the caller can fall back.
+ */
+static gsmodel*
+loader_gsmodel_from_binary_ply(const char* fn, tpool* pool,
+                               const loader_options* opts) {
+  if (!loader_host_is_little_endian()) return NULL;
+
+  size_t size = 0;
+  const uint8_t* data = loader_map_file(fn, &size);
+  if (!data) return NULL;
+
+  ply_layout layout;
+  if (!loader_ply_parse_layout(data, size, &layout) ||
+      layout.n_vertices <= 0 ||
+      layout.data_offset + layout.n_vertices * layout.stride > size) {
+    loader_unmap_file(data, size);
+    return NULL;
+  }
+
+  size_t n = layout.n_vertices;
+  gsmodel* model = calloc(1, sizeof(gsmodel));
+  model->n_points = n;
+  model->positions = calloc(n, sizeof(vec3f));
+  model->colors = calloc(n, sizeof(vec3f));
+  model->opacities = calloc(n, sizeof(float));
+  model->scales = calloc(n, sizeof(vec3f));
+  model->rotations = calloc(n, sizeof(vec4f));
+  model->sh_degree = layout.sh_degree;
+  if (model->sh_degree > 0)
+    model->sh = calloc(n * 3 * sh_num_coeffs(model->sh_degree), sizeof(float));
+
+  posix_madvise((void*)data, size, POSIX_MADV_WILLNEED);
+
+  /* decode in batches if someone is waiting for the first points */
+  size_t batch = opts && opts->progress ? LOADER_PROGRESS_BATCH : n;
+  for (size_t first = 0; first < n; first += batch) {
+    size_t count = n - first < batch ? n - first : batch;
+    ply_decode_args args = {&layout, data + layout.data_offset, model, first};
+    tpool_parallel_for(pool, count, loader_num_chunks(count),
+                       loader_ply_decode_chunk, &args);
+    if (opts && opts->progress)
+      opts->progress(opts->progress_user, model, first + count);
+  }
+  loader_unmap_file(data, size);
+
+  return model;
+}
+
+/*
+ * Decodes .splat records [begin, end) straight from the file mapping. Colors
+ * and opacities are stored already activated, scales already exponentiated.
+ */
+static void
+loader_splat_decode_chunk(void* arg, size_t chunk, size_t begin, size_t end) {
+  splat_decode_args* args = arg;
+  gsmodel* model = args->model;
+  const splat_record* records = args->records;
+  (void)chunk;
+
+  for (size_t i = begin; i < end; ++i) {
+    const splat_record* r = &records[i];
+    for (int j = 0; j < 3; ++j) {
+      model->positions[i].v[j] = r->position[j];
+      model->colors[i].v[j] = r->color[j] / 255.f;
+      model->scales[i].v[j] = r->scale[j];
+    }
+    model->opacities[i] = r->color[3] / 255.f;
+
+    vec4f q;
+    for (int j = 0; j < 4; ++j) {
+      q.v[j] = (r->rotation[j] - 128.f) / 128.f;
+    }
+    model->rotations[i] = norm4(q);
+  }
+}
+
+gsmodel*
+loader_gsmodel_from_splat(const char* fn, const loader_options* opts) {
+  size_t size = 0;
+  const uint8_t* data = loader_map_file(fn, &size);
+  if (!data) {
+    printf("[loader] unable to open file %s\n", fn);
+    return NULL;
+  }
+  if (size % sizeof(splat_record) != 0) {
+    loader_unmap_file(data, size);
+    printf("[loader] %s is not a valid .splat file\n", fn);
+    return NULL;
+  }
+
+  size_t n = size / sizeof(splat_record);
+  gsmodel* model = calloc(1, sizeof(gsmodel));
+  model->n_points = n;
+  model->positions = calloc(n, sizeof(vec3f));
+  model->colors = calloc(n, sizeof(vec3f));
+  model->opacities = calloc(n, sizeof(float));
+  model->scales = calloc(n, sizeof(vec3f));
+  model->rotations = calloc(n, sizeof(vec4f));
+
+  int owns_pool;
+  tpool* pool = loader_acquire_pool(opts, &owns_pool);
+
+  posix_madvise((void*)data, size, POSIX_MADV_WILLNEED);
+  splat_decode_args args = {(const splat_record*)data, model};
+  tpool_parallel_for(pool, n, loader_num_chunks(n), loader_splat_decode_chunk,
+                     &args);
+
+  loader_release_pool(pool, owns_pool);
+  loader_unmap_file(data, size);
+
+  printf("[loader] loaded SPLAT file %s\n", fn);
+  return model;
+}
+
 gsmodel*
 loader_gsmodel_debug() {
   gsmodel* model = calloc(1, sizeof(gsmodel));
@@ -104,33 +566,335 @@ loader_gsmodel_debug() {
   model->positions = calloc(1, sizeof(vec3f));
   model->colors = calloc(1, sizeof(vec3f));
   model->opacities = calloc(1, sizeof(float));
-  model->cov3d = calloc(1, sizeof(mat3));
+  model->scales = calloc(1, sizeof(vec3f));
+  model->rotations = calloc(1, sizeof(vec4f));
   model->n_points = 1;
 
   model->positions[0] = (vec3f){0.f, 0.f, 0.f};
   model->colors[0] = (vec3f){1.f, 0.f, 0.f};
   model->opacities[0] = 1.f;
-  model->cov3d[0] = mat3_id();
-  model->cov3d[0].vv[0][0] = 0.005f;
+  model->scales[0] = (vec3f){{sqrtf(0.005f), 1.f, 1.f}};
+  model->rotations[0] = (vec4f){{1.f, 0.f, 0.f, 0.f}};
 
   printf("[loader] loaded debug model\n");
   return model;
 }
 
+static void
+loader_sogs_read_image(void* arg, size_t chunk, size_t begin, size_t end) {
+  sogs_bundle* bundle = arg;
+  (void)chunk;
+  for (size_t i = begin; i < end; ++i) {
+    sogs_image_file* image = &bundle->images[i];
+    if (image->path[0] == '\0') continue;
+    image->pixels = image_read_rgba(image->path, &image->width, &image->height);
+  }
+}
+
+static float
+loader_sogs_lerp(float min, float max, float t) {
+  return min + (max - min) * t;
+}
+
+/* inverse of the symmetric log transform applied to positions */
+static float
+loader_sogs_unlog(float v) {
+  return copysignf(expf(fabsf(v)) - 1.f, v);
+}
+
+/*
+ * Higher SH bands are palettized: a 16-bit label per point selects a centroid
+ * in the centroid image, which stores one rgb pixel per coefficient and
+ * SOGS_SH_CENTROIDS_PER_ROW centroids per row.
+ */
+static void
+loader_sogs_decode_sh(sogs_bundle* bundle, size_t begin, size_t end) {
+  gsmodel* model = bundle->model;
+  const sogs_image_file* centroids = &bundle->images[SOGS_SH_CENTROIDS];
+  const uint8_t* labels = bundle->images[SOGS_SH_LABELS].pixels;
+  const size_t n_coeffs = sh_num_coeffs(model->sh_degree);
+
+  for (size_t i = begin; i < end; ++i) {
+    float* sh = model->sh + i * 3 * n_coeffs;
+    size_t label = labels[4 * i] | (labels[4 * i + 1] << 8);
+    size_t x = (label % SOGS_SH_CENTROIDS_PER_ROW) * n_coeffs;
+    size_t y = label / SOGS_SH_CENTROIDS_PER_ROW;
+    if (y >= centroids->height) continue;
+
+    const uint8_t* px = centroids->pixels + 4 * (y * centroids->width + x);
+    for (size_t k = 0; k < 3 * n_coeffs; ++k) {
+      uint8_t v = px[(k / 3) * 4 + k % 3];
+      sh[k] = bundle->version >= 2
+                  ? bundle->shn_codebook[v]
+                  : loader_sogs_lerp(bundle->shn_min, bundle->shn_max,
+                                     v / 255.f);
+    }
+  }
+}
+
+static void
+loader_sogs_decode_chunk(void* arg, size_t chunk, size_t begin, size_t end) {
+  sogs_bundle* bundle = arg;
+  gsmodel* model = bundle->model;
+  const uint8_t* means_l = bundle->images[SOGS_MEANS_L].pixels;
+  const uint8_t* means_u = bundle->images[SOGS_MEANS_U].pixels;
+  const uint8_t* scales_px = bundle->images[SOGS_SCALES].pixels;
+  const uint8_t* quats_px = bundle->images[SOGS_QUATS].pixels;
+  const uint8_t* sh0_px = bundle->images[SOGS_SH0].pixels;
+  (void)chunk;
+
+  for (size_t i = begin; i < end; ++i) {
+    const size_t px = 4 * i;
+
+    for (int j = 0; j < 3; ++j) {
+      float t = (means_l[px + j] | (means_u[px + j] << 8)) / 65535.f;
+      model->positions[i].v[j] = loader_sogs_unlog(
+          loader_sogs_lerp(bundle->means_min[j], bundle->means_max[j], t));
+    }
+
+    for (int j = 0; j < 3; ++j) {
+      float s = bundle->version >= 2
+                    ? bundle->scales_codebook[scales_px[px + j]]
+                    : loader_sogs_lerp(bundle->scales_min[j],
+                                       bundle->scales_max[j],
+                                       scales_px[px + j] / 255.f);
+      model->scales[i].v[j] = expf(s);
+    }
+
+    /* three smallest components, the largest one is stored in alpha */
+    float r[3], sum = 0.f;
+    for (int j = 0; j < 3; ++j) {
+      r[j] = (quats_px[px + j] / 255.f - 0.5f) * SQRT2;
+      sum += r[j] * r[j];
+    }
+    int largest = (quats_px[px + 3] - 252) & 3;
+    vec4f q;
+    for (int j = 0, k = 0; j < 4; ++j) {
+      q.v[j] = j == largest ? sqrtf(fmaxf(0.f, 1.f - sum)) : r[k++];
+    }
+    model->rotations[i] = q;
+
+    for (int j = 0; j < 3; ++j) {
+      float dc = bundle->version >= 2
+                     ? bundle->sh0_codebook[sh0_px[px + j]]
+                     : loader_sogs_lerp(bundle->sh0_min[j], bundle->sh0_max[j],
+                                        sh0_px[px + j] / 255.f);
+      model->colors[i].v[j] = dc * C0 + 0.5f;
+    }
+    if (bundle->version >= 2) {
+      model->opacities[i] = sh0_px[px + 3] / 255.f;
+    } else {
+      float logit = loader_sogs_lerp(bundle->sh0_min[3], bundle->sh0_max[3],
+                                     sh0_px[px + 3] / 255.f);
+      model->opacities[i] = 1.f / (1.f + expf(-logit));
+    }
+  }
+
+  if (model->sh_degree > 0) loader_sogs_decode_sh(bundle, begin, end);
+}
+
+static int
+loader_sogs_read_floats(const json_value* array, float* dst, size_t n) {
+  if (json_length(array) < n) return 0;
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = (float)json_number(json_at(array, i), 0.0);
+  }
+  return 1;
+}
+
+static int
+loader_sogs_set_path(sogs_image_file* image, const char* dir,
+                     const json_value* attribute, size_t file) {
+  const char* name = json_string(json_at(json_get(attribute, "files"), file));
+  if (!name) return 0;
+  int len = snprintf(image->path, SOGS_MAX_PATH, "%s%s", dir, name);
+  return len > 0 && len < SOGS_MAX_PATH;
+}
+
+/* Reads the attribute ranges, codebooks and image paths from meta.json. */
+static int
+loader_sogs_parse_meta(const json_value* meta, const char* dir,
+                       sogs_bundle* bundle, long* n_points) {
+  const json_value* means = json_get(meta, "means");
+  const json_value* scales = json_get(meta, "scales");
+  const json_value* quats = json_get(meta, "quats");
+  const json_value* sh0 = json_get(meta, "sh0");
+  if (!means || !scales || !quats || !sh0) return 0;
+
+  bundle->version = (int)json_number(json_get(meta, "version"), 1.0);
+  if (bundle->version >= 2) {
+    *n_points = (long)json_number(json_get(meta, "count"), 0.0);
+  } else {
+    *n_points = (long)json_number(json_at(json_get(means, "shape"), 0), 0.0);
+  }
+
+  if (!loader_sogs_read_floats(json_get(means, "mins"), bundle->means_min, 3) ||
+      !loader_sogs_read_floats(json_get(means, "maxs"), bundle->means_max, 3))
+    return 0;
+
+  if (bundle->version >= 2) {
+    if (!loader_sogs_read_floats(json_get(scales, "codebook"),
+                                 bundle->scales_codebook, SOGS_CODEBOOK_SIZE) ||
+        !loader_sogs_read_floats(json_get(sh0, "codebook"),
+                                 bundle->sh0_codebook, SOGS_CODEBOOK_SIZE))
+      return 0;
+  } else {
+    if (!loader_sogs_read_floats(json_get(scales, "mins"), bundle->scales_min,
+                                 3) ||
+        !loader_sogs_read_floats(json_get(scales, "maxs"), bundle->scales_max,
+                                 3) ||
+        !loader_sogs_read_floats(json_get(sh0, "mins"), bundle->sh0_min, 4) ||
+        !loader_sogs_read_floats(json_get(sh0, "maxs"), bundle->sh0_max, 4))
+      return 0;
+  }
+
+  const json_value* shn = json_get(meta, "shN");
+  if (shn) {
+    if (bundle->version >= 2) {
+      if (!loader_sogs_read_floats(json_get(shn, "codebook"),
+                                   bundle->shn_codebook, SOGS_CODEBOOK_SIZE))
+        return 0;
+    } else {
+      /* ranges are shared by all coefficients, possibly wrapped in arrays */
+      const json_value* min = json_get(shn, "mins");
+      const json_value* max = json_get(shn, "maxs");
+      bundle->shn_min = json_number(json_at(min, 0), json_number(min, 0));
+      bundle->shn_max = json_number(json_at(max, 0), json_number(max, 0));
+    }
+    if (!loader_sogs_set_path(&bundle->images[SOGS_SH_CENTROIDS], dir, shn,
+                              0) ||
+        !loader_sogs_set_path(&bundle->images[SOGS_SH_LABELS], dir, shn, 1))
+      return 0;
+  }
+
+  return loader_sogs_set_path(&bundle->images[SOGS_MEANS_L], dir, means, 0) &&
+         loader_sogs_set_path(&bundle->images[SOGS_MEANS_U], dir, means, 1) &&
+         loader_sogs_set_path(&bundle->images[SOGS_SCALES], dir, scales, 0) &&
+         loader_sogs_set_path(&bundle->images[SOGS_QUATS], dir, quats, 0) &&
+         loader_sogs_set_path(&bundle->images[SOGS_SH0], dir, sh0, 0);
+}
+
+/*
+ * Loads an unpacked SOGS bundle from its meta.json (or the directory holding
+ * it). Attribute images are PNG files, or WebP if the build links libwebp.
+ */
 gsmodel*
-loader_gsmodel_from_sogs(const char* fn) {
-  return NULL;
+loader_gsmodel_from_sogs(const char* fn, const loader_options* opts) {
+  char dir[SOGS_MAX_PATH];
+  char meta_fn[SOGS_MAX_PATH];
+
+  size_t len = strlen(fn);
+  if (len >= 5 && strcmp(fn + len - 5, ".json") == 0) {
+    const char* slash = strrchr(fn, '/');
+    size_t dir_len = slash ? (size_t)(slash - fn) + 1 : 0;
+    if (dir_len >= SOGS_MAX_PATH || len >= SOGS_MAX_PATH) return NULL;
+    memcpy(dir, fn, dir_len);
+    dir[dir_len] = '\0';
+    memcpy(meta_fn, fn, len + 1);
+  } else {
+    const char* sep = len > 0 && fn[len - 1] == '/' ? "" : "/";
+    int dir_len = snprintf(dir, SOGS_MAX_PATH, "%s%s", fn, sep);
+    int meta_len = snprintf(meta_fn, SOGS_MAX_PATH, "%smeta.json", dir);
+    if (dir_len < 0 || dir_len >= SOGS_MAX_PATH || meta_len < 0 ||
+        meta_len >= SOGS_MAX_PATH) {
+      printf("[loader] SOGS path too long %s\n", fn);
+      return NULL;
+    }
+  }
+
+  json_value* meta = json_parse_file(meta_fn);
+  if (!meta) {
+    printf("[loader] unable to parse SOGS metadata %s\n", meta_fn);
+    return NULL;
+  }
+
+  sogs_bundle* bundle = calloc(1, sizeof(sogs_bundle));
+  long n_points = 0;
+  int ok = loader_sogs_parse_meta(meta, dir, bundle, &n_points);
+  json_destroy(meta);
+  if (!ok || n_points <= 0) {
+    free(bundle);
+    printf("[loader] unsupported SOGS metadata in %s\n", meta_fn);
+    return NULL;
+  }
+
+  int owns_pool;
+  tpool* pool = loader_acquire_pool(opts, &owns_pool);
+
+  /* one task per attribute image, then one per chunk of points */
+  tpool_parallel_for(pool, SOGS_IMAGE_COUNT, SOGS_IMAGE_COUNT,
+                     loader_sogs_read_image, bundle);
+
+  for (int i = 0; i < SOGS_IMAGE_COUNT; ++i) {
+    const sogs_image_file* image = &bundle->images[i];
+    if (image->path[0] == '\0' && i >= SOGS_SH_CENTROIDS) continue;
+
+    size_t min_pixels = i == SOGS_SH_CENTROIDS ? 1 : (size_t)n_points;
+    if (!image->pixels || image->width * image->height < min_pixels) {
+      printf("[loader] unable to read SOGS image %s\n", image->path);
+      ok = 0;
+    }
+  }
+
+  int sh_degree = 0;
+  if (ok && bundle->images[SOGS_SH_CENTROIDS].pixels) {
+    size_t width = bundle->images[SOGS_SH_CENTROIDS].width;
+    sh_degree = sh_degree_from_rest(3 * width / SOGS_SH_CENTROIDS_PER_ROW);
+    if (sh_degree < 0 || width % SOGS_SH_CENTROIDS_PER_ROW != 0) sh_degree = 0;
+  }
+
+  gsmodel* model = NULL;
+  if (ok) {
+    size_t n = n_points;
+    model = calloc(1, sizeof(gsmodel));
+    model->n_points = n;
+    model->positions = calloc(n, sizeof(vec3f));
+    model->colors = calloc(n, sizeof(vec3f));
+    model->opacities = calloc(n, sizeof(float));
+    model->scales = calloc(n, sizeof(vec3f));
+    model->rotations = calloc(n, sizeof(vec4f));
+    model->sh_degree = sh_degree;
+    if (sh_degree > 0)
+      model->sh = calloc(n * 3 * sh_num_coeffs(sh_degree), sizeof(float));
+
+    bundle->model = model;
+    tpool_parallel_for(pool, n, loader_num_chunks(n), loader_sogs_decode_chunk,
+                       bundle);
+    printf("[loader] loaded SOGS file %s\n", meta_fn);
+  }
+
+  loader_release_pool(pool, owns_pool);
+  for (int i = 0; i < SOGS_IMAGE_COUNT; ++i) {
+    free(bundle->images[i].pixels);
+  }
+  free(bundle);
+
+  return model;
 }
 
 gsmodel*
-loader_gsmodel_from_ply(const char* fn) {
+loader_gsmodel_from_ply(const char* fn, const loader_options* opts) {
+  int owns_pool;
+  tpool* pool = loader_acquire_pool(opts, &owns_pool);
+
+  /* binary files with a plain vertex layout skip rply entirely */
+  gsmodel* fast_model = loader_gsmodel_from_binary_ply(fn, pool, opts);
+  if (fast_model) {
+    loader_release_pool(pool, owns_pool);
+    printf("[loader] loaded PLY file %s\n", fn);
+    return fast_model;
+  }
+
   /* load file */
   p_ply ply = ply_open(fn, NULL, 0L, NULL);
   if (!ply) {
+    loader_release_pool(pool, owns_pool);
     printf("[loader] unable to open file %s\n", fn);
     return NULL;
   }
   if (!ply_read_header(ply)) {
+    ply_close(ply);
+    loader_release_pool(pool, owns_pool);
     printf("[loader] unable to parse PLY header\n");
     return NULL;
   }
@@ -169,42 +933,934 @@ loader_gsmodel_from_ply(const char* fn) {
                   &read_payload, 13L);
   assert(num_x == num_y && num_y == num_z);
 
+  size_t n_rest = 0;
+  for (; n_rest < PLY_MAX_REST; ++n_rest) {
+    char name[16];
+    snprintf(name, sizeof(name), "f_rest_%zu", n_rest);
+    if (!ply_set_read_cb(ply, "vertex", name, &loader_ply_read_callback,
+                         &read_payload, PLY_REST_DIM + n_rest))
+      break;
+  }
+  model->sh_degree = sh_degree_from_rest(n_rest);
+  if (model->sh_degree < 0) model->sh_degree = 0;
+  if (model->sh_degree > 0) {
+    model->sh =
+        calloc(num_x * 3 * sh_num_coeffs(model->sh_degree), sizeof(float));
+  }
+
   model->positions = calloc(num_x, sizeof(vec3f));
   model->colors = calloc(num_x, sizeof(vec3f));
   model->opacities = calloc(num_x, sizeof(float));
-  model->cov3d = calloc(num_x, sizeof(mat3));
-
-  read_payload.scales = calloc(num_x, sizeof(vec3f));
-  read_payload.rotations = calloc(num_x, sizeof(vec4f));
+  model->scales = calloc(num_x, sizeof(vec3f));
+  model->rotations = calloc(num_x, sizeof(vec4f));
   model->n_points = 0;
 
   int ok = ply_read(ply);
+  ply_close(ply);
 
   model->n_points = read_payload.points_read / 3;
-  loader_compute_cov3d(&read_payload, model);
-
-  free(read_payload.scales);
-  free(read_payload.rotations);
+  tpool_parallel_for(pool, model->n_points, loader_num_chunks(model->n_points),
+                     loader_normalize_rotations_chunk, model);
+  loader_release_pool(pool, owns_pool);
 
   if (!ok) {
+    loader_gsmodel_destroy(model);
+    printf("[loader] unable to load PLY elements\n");
+    return NULL;
+  }
+
+  printf("[loader] loaded PLY file %s\n", fn);
+  return model;
+}
+
+static size_t
+loader_splatc_align(size_t offset) {
+  return (offset + SPLATC_ALIGNMENT - 1) & ~(size_t)(SPLATC_ALIGNMENT - 1);
+}
+
+static void*
+loader_splatc_section_data(const gsmodel* model, uint32_t kind,
+                           uint32_t* stride) {
+  switch (kind) {
+    case SPLATC_SECTION_POSITIONS:
+      *stride = sizeof(vec3f);
+      return model->positions;
+    case SPLATC_SECTION_COLORS:
+      *stride = sizeof(vec3f);
+      return model->colors;
+    case SPLATC_SECTION_OPACITIES:
+      *stride = sizeof(float);
+      return model->opacities;
+    case SPLATC_SECTION_SCALES:
+      *stride = sizeof(vec3f);
+      return model->scales;
+    case SPLATC_SECTION_ROTATIONS:
+      *stride = sizeof(vec4f);
+      return model->rotations;
+    case SPLATC_SECTION_SH:
+      *stride = 3 * sh_num_coeffs(model->sh_degree) * sizeof(float);
+      return model->sh;
+  }
+  *stride = 0;
+  return NULL;
+}
+
+/* writes n rows of a section, gathered through order if it is given */
+static int
+loader_splatc_write_rows(FILE* f, const uint8_t* data, size_t stride, size_t n,
+                         const uint32_t* order) {
+  if (!order) return fwrite(data, 1, stride * n, f) == stride * n;
+
+  uint8_t* block = malloc(stride * SPLATC_WRITE_BLOCK);
+  if (!block) return 0;
+
+  int ok = 1;
+  for (size_t begin = 0; ok && begin < n; begin += SPLATC_WRITE_BLOCK) {
+    size_t count = n - begin < SPLATC_WRITE_BLOCK ? n - begin
+                                                   : SPLATC_WRITE_BLOCK;
+    for (size_t i = 0; i < count; ++i) {
+      memcpy(block + i * stride, data + order[begin + i] * stride, stride);
+    }
+    ok = fwrite(block, stride, count, f) == count;
+  }
+  free(block);
+  return ok;
+}
+
+/*
+ * Writes the model as a .splatc file. If order is given, point i of the file
+ * is point order[i] of the model, and chunks (in file order) are stored in an
+ * additional chunk table section.
+ */
+static int
+loader_splatc_write(const gsmodel* model, const char* fn,
+                    const struct stat* source, const uint32_t* order,
+                    const splatc_chunk* chunks, size_t n_chunks) {
+  splatc_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SPLATC_MAGIC, sizeof(header.magic));
+  header.version = SPLATC_VERSION;
+  header.n_points = model->n_points;
+  header.sh_degree = model->sh_degree;
+  if (source) {
+    header.source_size = source->st_size;
+    header.source_mtime = source->st_mtime;
+  }
+
+  for (int j = 0; j < 3; ++j) {
+    header.bounds_min[j] = model->n_points > 0 ? INFINITY : 0.f;
+    header.bounds_max[j] = model->n_points > 0 ? -INFINITY : 0.f;
+  }
+  for (long i = 0; i < model->n_points; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      float v = model->positions[i].v[j];
+      header.bounds_min[j] = fminf(header.bounds_min[j], v);
+      header.bounds_max[j] = fmaxf(header.bounds_max[j], v);
+    }
+  }
+
+  size_t offset = loader_splatc_align(sizeof(splatc_header));
+  for (uint32_t kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+    uint32_t stride;
+    uint64_t n_rows = model->n_points;
+    if (kind == SPLATC_SECTION_CHUNKS) {
+      if (!chunks) continue;
+      stride = sizeof(splatc_chunk);
+      n_rows = n_chunks;
+    } else if (!loader_splatc_section_data(model, kind, &stride)) {
+      continue;
+    }
+
+    splatc_section* section = &header.sections[header.n_sections++];
+    section->kind = kind;
+    section->stride = stride;
+    section->offset = offset;
+    section->size = stride * n_rows;
+    offset = loader_splatc_align(offset + section->size);
+  }
+
+  /* write to a temporary file first so readers never see partial caches */
+  char tmp_fn[SOGS_MAX_PATH];
+  if (snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", fn) >= (int)sizeof(tmp_fn))
+    return 0;
+
+  FILE* f = fopen(tmp_fn, "wb");
+  if (!f) return 0;
+
+  static const uint8_t padding[SPLATC_ALIGNMENT] = {0};
+  size_t written = fwrite(&header, sizeof(header), 1, f) == 1;
+  size_t pos = sizeof(header);
+  for (uint32_t i = 0; written && i < header.n_sections; ++i) {
+    const splatc_section* section = &header.sections[i];
+    written = fwrite(padding, 1, section->offset - pos, f) ==
+              section->offset - pos;
+
+    if (section->kind == SPLATC_SECTION_CHUNKS) {
+      written = written && fwrite(chunks, 1, section->size, f) == section->size;
+    } else {
+      uint32_t stride;
+      const void* data =
+          loader_splatc_section_data(model, section->kind, &stride);
+      written = written && loader_splatc_write_rows(f, data, stride,
+                                                    model->n_points, order);
+    }
+    pos = section->offset + section->size;
+  }
+  written = written && fwrite(padding, 1, offset - pos, f) == offset - pos;
+
+  if (fclose(f) != 0 || !written || rename(tmp_fn, fn) != 0) {
+    remove(tmp_fn);
+    return 0;
+  }
+  return 1;
+}
+
+int
+loader_gsmodel_write_splatc(const gsmodel* model, const char* fn) {
+  /* caches hold the full precision arrays only */
+  if (!model || model->quantized || !loader_host_is_little_endian()) return 0;
+  return loader_splatc_write(model, fn, NULL, NULL, NULL, 0);
+}
+
+typedef struct {
+  float key;
+  uint32_t idx;
+} loader_sort_key;
+
+static int
+loader_compare_sort_keys(const void* a, const void* b) {
+  float ka = ((const loader_sort_key*)a)->key;
+  float kb = ((const loader_sort_key*)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Splits order[begin, end) at the median of the longest axis of its bounds
+ * until every part holds at most chunk_size points, and appends one chunk
+ * per part. keys is scratch space for at least end - begin entries.
+ */
+static int
+loader_splatc_partition(const vec3f* positions, uint32_t* order,
+                        loader_sort_key* keys, size_t begin, size_t end,
+                        size_t chunk_size, splatc_chunk** chunks,
+                        size_t* n_chunks, size_t* capacity) {
+  splatc_chunk chunk = {{INFINITY, INFINITY, INFINITY},
+                        {-INFINITY, -INFINITY, -INFINITY},
+                        begin,
+                        end - begin};
+  for (size_t i = begin; i < end; ++i) {
+    vec3f p = positions[order[i]];
+    for (int j = 0; j < 3; ++j) {
+      chunk.bounds_min[j] = fminf(chunk.bounds_min[j], p.v[j]);
+      chunk.bounds_max[j] = fmaxf(chunk.bounds_max[j], p.v[j]);
+    }
+  }
+
+  if (end - begin <= chunk_size) {
+    if (*n_chunks == *capacity) {
+      *capacity = *capacity ? 2 * *capacity : 64;
+      splatc_chunk* grown = realloc(*chunks, *capacity * sizeof(splatc_chunk));
+      if (!grown) return 0;
+      *chunks = grown;
+    }
+    (*chunks)[(*n_chunks)++] = chunk;
+    return 1;
+  }
+
+  int axis = 0;
+  for (int j = 1; j < 3; ++j) {
+    if (chunk.bounds_max[j] - chunk.bounds_min[j] >
+        chunk.bounds_max[axis] - chunk.bounds_min[axis])
+      axis = j;
+  }
+
+  size_t n = end - begin;
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = (loader_sort_key){positions[order[begin + i]].v[axis],
+                                order[begin + i]};
+  }
+  qsort(keys, n, sizeof(loader_sort_key), loader_compare_sort_keys);
+  for (size_t i = 0; i < n; ++i) order[begin + i] = keys[i].idx;
+
+  size_t mid = begin + n / 2;
+  return loader_splatc_partition(positions, order, keys, begin, mid,
+                                 chunk_size, chunks, n_chunks, capacity) &&
+         loader_splatc_partition(positions, order, keys, mid, end, chunk_size,
+                                 chunks, n_chunks, capacity);
+}
+
+int
+loader_gsmodel_write_splatc_chunked(const gsmodel* model, const char* fn,
+                                    size_t chunk_size) {
+  if (!model || model->quantized || !loader_host_is_little_endian() ||
+      chunk_size == 0 || (uint64_t)model->n_points > UINT32_MAX)
+    return 0;
+
+  size_t n = model->n_points;
+  uint32_t* order = malloc(n * sizeof(uint32_t));
+  loader_sort_key* keys = malloc(n * sizeof(loader_sort_key));
+  splatc_chunk* chunks = NULL;
+  size_t n_chunks = 0, capacity = 0;
+
+  int ok = order && keys;
+  if (ok) {
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    ok = loader_splatc_partition(model->positions, order, keys, 0, n,
+                                 chunk_size, &chunks, &n_chunks, &capacity);
+  }
+  free(keys);
+
+  ok = ok && loader_splatc_write(model, fn, NULL, order, chunks, n_chunks);
+  if (ok) {
+    printf("[loader] wrote %zu chunks of up to %zu points to %s\n", n_chunks,
+           chunk_size, fn);
+  }
+
+  free(order);
+  free(chunks);
+  return ok;
+}
+
+/*
+ * Maps a .splatc file and points the model arrays straight into the mapping.
+ * The mapping is private, so later in-place edits of the arrays never reach
+ * the file. If source is given, caches built from a different version of the
+ * source file are rejected.
+ */
+static gsmodel*
+loader_splatc_map(const char* fn, const struct stat* source) {
+  if (!loader_host_is_little_endian()) return NULL;
+
+  int fd = open(fn, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(splatc_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = st.st_size;
+  uint8_t* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  const splatc_header* header = (const splatc_header*)data;
+  int ok = memcmp(header->magic, SPLATC_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == SPLATC_VERSION &&
+           header->n_sections <= SPLATC_MAX_SECTIONS &&
+           header->sh_degree <= SH_MAX_DEGREE;
+  if (ok && source) {
+    ok = header->source_size == (uint64_t)source->st_size &&
+         header->source_mtime == (int64_t)source->st_mtime;
+  }
+
+  gsmodel* model = calloc(1, sizeof(gsmodel));
+  model->n_points = ok ? (long)header->n_points : 0;
+  model->sh_degree = ok ? (int)header->sh_degree : 0;
+  model->mapping = data;
+  model->mapping_size = size;
+
+  for (uint32_t i = 0; ok && i < header->n_sections; ++i) {
+    const splatc_section* section = &header->sections[i];
+    if (section->kind == SPLATC_SECTION_CHUNKS) continue; /* streaming only */
+
+    uint32_t stride;
+    loader_splatc_section_data(model, section->kind, &stride);
+
+    ok = stride != 0 && section->stride == stride &&
+         section->offset % SPLATC_ALIGNMENT == 0 &&
+         section->size == (uint64_t)stride * header->n_points &&
+         section->offset + section->size <= size;
+    if (!ok) break;
+
+    void* array = data + section->offset;
+    switch (section->kind) {
+      case SPLATC_SECTION_POSITIONS:
+        model->positions = array;
+        break;
+      case SPLATC_SECTION_COLORS:
+        model->colors = array;
+        break;
+      case SPLATC_SECTION_OPACITIES:
+        model->opacities = array;
+        break;
+      case SPLATC_SECTION_SCALES:
+        model->scales = array;
+        break;
+      case SPLATC_SECTION_ROTATIONS:
+        model->rotations = array;
+        break;
+      case SPLATC_SECTION_SH:
+        model->sh = array;
+        break;
+    }
+  }
+
+  if (!ok || !model->positions || !model->colors || !model->opacities ||
+      !model->scales || !model->rotations ||
+      (model->sh_degree > 0 && !model->sh)) {
+    munmap(data, size);
+    free(model);
+    return NULL;
+  }
+
+  posix_madvise(data, size, POSIX_MADV_WILLNEED);
+  return model;
+}
+
+gsmodel*
+loader_gsmodel_from_splatc(const char* fn) {
+  gsmodel* model = loader_splatc_map(fn, NULL);
+  if (!model) {
+    printf("[loader] unable to map .splatc file %s\n", fn);
+    return NULL;
+  }
+
+  printf("[loader] mapped SPLATC file %s\n", fn);
+  return model;
+}
+
+static int
+loader_has_extension(const char* fn, const char* ext) {
+  size_t len = strlen(fn);
+  size_t ext_len = strlen(ext);
+  return len >= ext_len && strcmp(fn + len - ext_len, ext) == 0;
+}
+
+static gsmodel*
+loader_gsmodel_from_source(const char* fn, const loader_options* opts) {
+  if (loader_has_extension(fn, ".splatc"))
+    return loader_gsmodel_from_splatc(fn);
+  if (loader_has_extension(fn, ".splat"))
+    return loader_gsmodel_from_splat(fn, opts);
+  if (loader_has_extension(fn, ".json"))
+    return loader_gsmodel_from_sogs(fn, opts);
+
+  struct stat st;
+  if (stat(fn, &st) == 0 && S_ISDIR(st.st_mode))
+    return loader_gsmodel_from_sogs(fn, opts);
+  return loader_gsmodel_from_ply(fn, opts);
+}
+
+static void
+loader_gsmodel_free_arrays(gsmodel* model) {
+  if (model->mapping) {
+    munmap(model->mapping, model->mapping_size);
+    model->mapping = NULL;
+  } else {
     free(model->colors);
     free(model->positions);
     free(model->opacities);
-    free(model->cov3d);
-    free(model);
-    printf("[loader] unable to load PLY elements\n");
+    free(model->scales);
+    free(model->rotations);
+    free(model->sh);
+  }
+  model->positions = NULL;
+  model->colors = NULL;
+  model->opacities = NULL;
+  model->scales = NULL;
+  model->rotations = NULL;
+  model->sh = NULL;
+}
+
+static void
+loader_gsmodel_quantize(gsmodel* model, const loader_options* opts) {
+  int owns_pool;
+  tpool* pool = loader_acquire_pool(opts, &owns_pool);
+  gsmodel_quantized* quantized = quantize_gsmodel(model, pool);
+  loader_release_pool(pool, owns_pool);
+
+  if (!quantized) return;
+  loader_gsmodel_free_arrays(model);
+  model->quantized = quantized;
+}
+
+static void*
+loader_shrink(void* array, size_t size) {
+  void* shrunk = realloc(array, size ? size : 1);
+  return shrunk ? shrunk : array;
+}
+
+/*
+ * Points the arrays of model at new heap arrays for n points, with sh_values
+ * SH values per point, and clears its mapping. Returns 0 and leaves model
+ * alone if out of memory.
+ */
+static int
+loader_gsmodel_alloc_arrays(gsmodel* model, size_t n, size_t sh_values) {
+  gsmodel heap = *model;
+  heap.positions = malloc(n * sizeof(vec3f) + 1);
+  heap.colors = malloc(n * sizeof(vec3f) + 1);
+  heap.opacities = malloc(n * sizeof(float) + 1);
+  heap.scales = malloc(n * sizeof(vec3f) + 1);
+  heap.rotations = malloc(n * sizeof(vec4f) + 1);
+  heap.sh = sh_values ? malloc(n * sh_values * sizeof(float) + 1) : NULL;
+  heap.mapping = NULL;
+  if (!heap.positions || !heap.colors || !heap.opacities || !heap.scales ||
+      !heap.rotations || (sh_values && !heap.sh)) {
+    loader_gsmodel_free_arrays(&heap);
+    return 0;
+  }
+  *model = heap;
+  return 1;
+}
+
+static int
+loader_prune_keeps(const gsmodel* model, size_t i, const loader_options* opts) {
+  vec3f scale = model->scales[i];
+  float footprint = fmaxf(scale.x, fmaxf(scale.y, scale.z));
+  return model->opacities[i] >= opts->prune_opacity &&
+         footprint >= opts->prune_scale;
+}
+
+/*
+ * Drops splats below the opacity or footprint thresholds. Heap arrays are
+ * compacted in place and shrunk. Compacting a mapped cache would dirty its
+ * private pages, so its kept splats are copied to the heap instead and the
+ * cache is unmapped.
+ */
+static void
+loader_gsmodel_prune(gsmodel* model, const loader_options* opts) {
+  size_t sh_values = model->sh ? 3 * sh_num_coeffs(model->sh_degree) : 0;
+  size_t n = model->n_points, kept = 0;
+  for (size_t i = 0; i < n; ++i) kept += loader_prune_keeps(model, i, opts);
+
+  size_t point_size = 3 * sizeof(vec3f) + sizeof(float) + sizeof(vec4f) +
+                      sh_values * sizeof(float);
+  int mapped = model->mapping != NULL;
+  if (kept < n) {
+    gsmodel dst = *model;
+    if (mapped && !loader_gsmodel_alloc_arrays(&dst, kept, sh_values)) {
+      printf("[loader] unable to prune %zu splats\n", n);
+      return;
+    }
+
+    for (size_t i = 0, k = 0; i < n; ++i) {
+      if (!loader_prune_keeps(model, i, opts)) continue;
+      dst.positions[k] = model->positions[i];
+      dst.colors[k] = model->colors[i];
+      dst.opacities[k] = model->opacities[i];
+      dst.scales[k] = model->scales[i];
+      dst.rotations[k] = model->rotations[i];
+      if (sh_values)
+        memmove(dst.sh + k * sh_values, model->sh + i * sh_values,
+                sh_values * sizeof(float));
+      k++;
+    }
+
+    if (mapped) {
+      munmap(model->mapping, model->mapping_size);
+    } else {
+      dst.positions = loader_shrink(dst.positions, kept * sizeof(vec3f));
+      dst.colors = loader_shrink(dst.colors, kept * sizeof(vec3f));
+      dst.opacities = loader_shrink(dst.opacities, kept * sizeof(float));
+      dst.scales = loader_shrink(dst.scales, kept * sizeof(vec3f));
+      dst.rotations = loader_shrink(dst.rotations, kept * sizeof(vec4f));
+      if (dst.sh)
+        dst.sh = loader_shrink(dst.sh, kept * sh_values * sizeof(float));
+    }
+    dst.n_points = kept;
+    *model = dst;
+  }
+
+  double pruned = n ? 100.0 * (n - kept) / n : 0.0;
+  if (mapped && kept < n) {
+    printf("[loader] pruned %zu of %zu splats (%.1f%%), copied the other "
+           "%.1f MiB from the cache to the heap\n",
+           n - kept, n, pruned, kept * point_size / (1024.0 * 1024.0));
+  } else {
+    printf("[loader] pruned %zu of %zu splats (%.1f%%), %.1f MiB freed\n",
+           n - kept, n, pruned,
+           mapped ? 0.0 : (n - kept) * point_size / (1024.0 * 1024.0));
+  }
+}
+
+typedef struct {
+  const vec3f* positions;
+  vec3f min;
+  vec3f scale; /* maps the bounds to [0, 2^LOADER_MORTON_BITS) */
+  uint32_t* codes;
+  uint32_t* order;
+} morton_args;
+
+typedef struct {
+  const uint8_t* src;
+  uint8_t* dst;
+  size_t stride;
+  const uint32_t* order;
+} permute_args;
+
+/* spreads the lower 10 bits of v so that two zero bits follow each bit */
+static uint32_t
+loader_morton_spread(uint32_t v) {
+  v = (v | (v << 16)) & 0x030000FF;
+  v = (v | (v << 8)) & 0x0300F00F;
+  v = (v | (v << 4)) & 0x030C30C3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+static void
+loader_morton_chunk(void* arg, size_t chunk, size_t begin, size_t end) {
+  morton_args* args = arg;
+  const float max_cell = (1 << LOADER_MORTON_BITS) - 1;
+  (void)chunk;
+
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t cell[3];
+    for (int j = 0; j < 3; ++j) {
+      float t = (args->positions[i].v[j] - args->min.v[j]) * args->scale.v[j];
+      cell[j] = (uint32_t)fminf(fmaxf(t, 0.f), max_cell);
+    }
+    args->codes[i] = loader_morton_spread(cell[0]) |
+                     loader_morton_spread(cell[1]) << 1 |
+                     loader_morton_spread(cell[2]) << 2;
+    args->order[i] = i;
+  }
+}
+
+static void
+loader_permute_chunk(void* arg, size_t chunk, size_t begin, size_t end) {
+  permute_args* args = arg;
+  (void)chunk;
+  for (size_t i = begin; i < end; ++i) {
+    memcpy(args->dst + i * args->stride,
+           args->src + (size_t)args->order[i] * args->stride, args->stride);
+  }
+}
+
+/*
+ * Sets dst[i] to src[order[i]]. If dst is src, it goes through scratch, which
+ * holds n * stride bytes.
+ */
+static void
+loader_permute(const void* src, void* dst, size_t stride, size_t n,
+               const uint32_t* order, void* scratch, tpool* pool) {
+  permute_args args = {.src = src,
+                       .dst = src == dst ? scratch : dst,
+                       .stride = stride,
+                       .order = order};
+  tpool_parallel_for(pool, n, loader_num_chunks(n), loader_permute_chunk,
+                     &args);
+  if (src == dst) memcpy(dst, scratch, n * stride);
+}
+
+/*
+ * Sorts all arrays along a Morton curve through the bounds of the positions,
+ * so that splats that are close in space are also close in memory. Heap
+ * arrays are permuted in place. Permuting a mapped cache in place would dirty
+ * all of its private pages, so it is permuted into heap arrays instead and
+ * unmapped.
+ */
+static void
+loader_gsmodel_reorder(gsmodel* model, const loader_options* opts) {
+  size_t n = model->n_points;
+  if (n < 2 || (uint64_t)n > UINT32_MAX) return;
+
+  size_t sh_values = model->sh ? 3 * sh_num_coeffs(model->sh_degree) : 0;
+  size_t sh_stride = sh_values * sizeof(float);
+  size_t max_stride = sh_stride > sizeof(vec4f) ? sh_stride : sizeof(vec4f);
+  int mapped = model->mapping != NULL;
+  gsmodel dst = *model;
+  uint32_t* buffers = malloc(4 * n * sizeof(uint32_t));
+  void* scratch = mapped ? NULL : malloc(n * max_stride);
+  if (!buffers || (!mapped && !scratch) ||
+      (mapped && !loader_gsmodel_alloc_arrays(&dst, n, sh_values))) {
+    printf("[loader] unable to reorder %zu splats\n", n);
+    free(buffers);
+    free(scratch);
+    return;
+  }
+  uint32_t* codes = buffers;
+  uint32_t* order = buffers + n;
+
+  morton_args margs = {.positions = model->positions};
+  vec3f max;
+  for (int j = 0; j < 3; ++j) {
+    margs.min.v[j] = INFINITY;
+    max.v[j] = -INFINITY;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      margs.min.v[j] = fminf(margs.min.v[j], model->positions[i].v[j]);
+      max.v[j] = fmaxf(max.v[j], model->positions[i].v[j]);
+    }
+  }
+  for (int j = 0; j < 3; ++j) {
+    float extent = max.v[j] - margs.min.v[j];
+    margs.scale.v[j] =
+        extent > 0.f ? (1 << LOADER_MORTON_BITS) / extent : 0.f;
+  }
+  margs.codes = codes;
+  margs.order = order;
+
+  int owns_pool;
+  tpool* pool = loader_acquire_pool(opts, &owns_pool);
+  tpool_parallel_for(pool, n, loader_num_chunks(n), loader_morton_chunk,
+                     &margs);
+  sort_radix_u32(pool, codes, order, buffers + 2 * n, buffers + 3 * n, n);
+
+  loader_permute(model->positions, dst.positions, sizeof(vec3f), n, order,
+                 scratch, pool);
+  loader_permute(model->colors, dst.colors, sizeof(vec3f), n, order, scratch,
+                 pool);
+  loader_permute(model->opacities, dst.opacities, sizeof(float), n, order,
+                 scratch, pool);
+  loader_permute(model->scales, dst.scales, sizeof(vec3f), n, order, scratch,
+                 pool);
+  loader_permute(model->rotations, dst.rotations, sizeof(vec4f), n, order,
+                 scratch, pool);
+  if (model->sh)
+    loader_permute(model->sh, dst.sh, sh_stride, n, order, scratch, pool);
+  loader_release_pool(pool, owns_pool);
+
+  if (mapped) munmap(model->mapping, model->mapping_size);
+  *model = dst;
+
+  free(buffers);
+  free(scratch);
+  printf("[loader] reordered %zu splats along a Morton curve\n", n);
+}
+
+/*
+ * Point order by decreasing opacity times volume, so that a prefix of the
+ * points already shows a coarse version of the scene. Returns NULL if out of
+ * memory.
+ */
+static uint32_t*
+loader_importance_order(const gsmodel* model) {
+  size_t n = model->n_points;
+  if ((uint64_t)n > UINT32_MAX) return NULL;
+
+  uint32_t* order = malloc(n * sizeof(uint32_t) + 1);
+  uint32_t* scratch = malloc(3 * n * sizeof(uint32_t) + 1);
+  if (!order || !scratch) {
+    free(order);
+    free(scratch);
     return NULL;
   }
 
-  printf("[loader] loaded PLY file %s\n", fn);
+  uint32_t* keys = scratch;
+  for (size_t i = 0; i < n; ++i) {
+    vec3f s = model->scales[i];
+    float importance = fabsf(model->opacities[i] * s.x * s.y * s.z);
+
+    /* non-negative floats sort like their bits, inverted for descending */
+    uint32_t bits;
+    memcpy(&bits, &importance, sizeof(bits));
+    keys[i] = ~bits;
+    order[i] = i;
+  }
+  sort_radix_u32(NULL, keys, order, scratch + n, scratch + 2 * n, n);
+  free(scratch);
+  return order;
+}
+
+static gsmodel*
+loader_gsmodel_from_cache(const char* fn, const loader_options* opts) {
+  struct stat source;
+  if (!opts || opts->cache == LOADER_CACHE_OFF ||
+      loader_has_extension(fn, ".splatc") || stat(fn, &source) != 0)
+    return loader_gsmodel_from_source(fn, opts);
+
+  /* the cache lives next to the source, directories get a sibling file */
+  char cache_fn[SOGS_MAX_PATH];
+  size_t len = strlen(fn);
+  while (len > 1 && fn[len - 1] == '/') len--;
+  if (snprintf(cache_fn, sizeof(cache_fn), "%.*s.splatc", (int)len, fn) >=
+      (int)sizeof(cache_fn))
+    return loader_gsmodel_from_source(fn, opts);
+
+  gsmodel* model = loader_splatc_map(cache_fn, &source);
+  if (model) {
+    printf("[loader] mapped SPLATC cache %s\n", cache_fn);
+    return model;
+  }
+
+  model = loader_gsmodel_from_source(fn, opts);
+  if (model && loader_host_is_little_endian()) {
+    /* caches are read back in importance order by progressive loads */
+    uint32_t* order = loader_importance_order(model);
+    if (loader_splatc_write(model, cache_fn, &source, order, NULL, 0)) {
+      printf("[loader] wrote SPLATC cache %s\n", cache_fn);
+    } else {
+      printf("[loader] unable to write SPLATC cache %s\n", cache_fn);
+    }
+    free(order);
+  }
+  return model;
+}
+
+gsmodel*
+loader_gsmodel_load(const char* fn, const loader_options* opts) {
+  /* progress is only reported for arrays that are not rewritten later */
+  loader_options local;
+  if (opts && opts->progress &&
+      (opts->prune_opacity > 0.f || opts->prune_scale > 0.f ||
+       opts->reorder != LOADER_REORDER_OFF || opts->quantize ||
+       opts->build_bvh || opts->build_lod)) {
+    local = *opts;
+    local.progress = NULL;
+    opts = &local;
+  }
+
+  gsmodel* model = loader_gsmodel_from_cache(fn, opts);
+  if (model && opts && (opts->prune_opacity > 0.f || opts->prune_scale > 0.f))
+    loader_gsmodel_prune(model, opts);
+  if (model && opts &&
+      (opts->reorder == LOADER_REORDER_MORTON || opts->build_bvh ||
+       opts->build_lod))
+    loader_gsmodel_reorder(model, opts);
+  if (model && opts && opts->quantize) loader_gsmodel_quantize(model, opts);
+  if (model && opts && (opts->build_bvh || opts->build_lod)) {
+    int owns_pool;
+    tpool* pool = loader_acquire_pool(opts, &owns_pool);
+    if (opts->build_bvh) model->bvh = bvh_build(model, pool);
+    if (opts->build_lod) model->lod = lod_build(model, pool);
+    loader_release_pool(pool, owns_pool);
+  }
   return model;
 }
 
 void
 loader_gsmodel_destroy(gsmodel* model) {
-  free(model->colors);
-  free(model->positions);
-  free(model->opacities);
-  free(model->cov3d);
+  loader_gsmodel_free_arrays(model);
+  quantize_destroy(model->quantized);
+  bvh_destroy(model->bvh);
+  lod_destroy(model->lod);
   free(model);
 }
+
+struct loader_async_t {
+  pthread_t thread;
+  char* fn;
+  loader_options opts;
+  gsmodel* model; /* the public view, only changed by loader_async_poll */
+
+  pthread_mutex_t lock;
+  const gsmodel* loading; /* model owned by the thread, NULL until known */
+  size_t n_ready;
+  loader_async_state state;
+};
+
+static void
+loader_async_progress(void* user, const gsmodel* model, size_t n_ready) {
+  loader_async* async = user;
+  pthread_mutex_lock(&async->lock);
+  async->loading = model;
+  async->n_ready = n_ready;
+  pthread_mutex_unlock(&async->lock);
+}
+
+/* reads one byte per page of elements [begin, end) to fault them in */
+static void
+loader_touch(const void* array, size_t stride, size_t begin, size_t end) {
+  if (!array || begin >= end) return;
+  const volatile uint8_t* data = (const uint8_t*)array + begin * stride;
+  size_t size = (end - begin) * stride;
+  for (size_t offset = 0; offset < size; offset += LOADER_PAGE_SIZE) {
+    (void)data[offset];
+  }
+  (void)data[size - 1];
+}
+
+static void*
+loader_async_run(void* arg) {
+  loader_async* async = arg;
+  loader_options opts = async->opts;
+  opts.progress = loader_async_progress;
+  opts.progress_user = async;
+  gsmodel* model = loader_gsmodel_load(async->fn, &opts);
+
+  /*
+   * Publish whatever the loader did not report yet in batches. Mapped caches
+   * are paged in along the way, which makes them fill in progressively.
+   */
+  pthread_mutex_lock(&async->lock);
+  size_t first = async->loading == model ? async->n_ready : 0;
+  pthread_mutex_unlock(&async->lock);
+
+  size_t n = model ? model->n_points : 0;
+  size_t sh_stride = model ? 3 * sh_num_coeffs(model->sh_degree) : 0;
+  for (; first < n; first += LOADER_PROGRESS_BATCH) {
+    size_t end = n - first < LOADER_PROGRESS_BATCH
+                     ? n
+                     : first + LOADER_PROGRESS_BATCH;
+    if (model->mapping) {
+      loader_touch(model->positions, sizeof(vec3f), first, end);
+      loader_touch(model->colors, sizeof(vec3f), first, end);
+      loader_touch(model->opacities, sizeof(float), first, end);
+      loader_touch(model->scales, sizeof(vec3f), first, end);
+      loader_touch(model->rotations, sizeof(vec4f), first, end);
+      loader_touch(model->sh, sh_stride * sizeof(float), first, end);
+    }
+    loader_async_progress(async, model, end);
+  }
+
+  pthread_mutex_lock(&async->lock);
+  async->loading = model;
+  async->n_ready = n;
+  async->state = model ? LOADER_ASYNC_DONE : LOADER_ASYNC_FAILED;
+  pthread_mutex_unlock(&async->lock);
+  return NULL;
+}
+
+loader_async*
+loader_gsmodel_load_async(const char* fn, const loader_options* opts) {
+  loader_async* async = calloc(1, sizeof(loader_async));
+  async->fn = malloc(strlen(fn) + 1);
+  strcpy(async->fn, fn);
+  if (opts) async->opts = *opts;
+  async->model = calloc(1, sizeof(gsmodel));
+  async->state = LOADER_ASYNC_LOADING;
+  pthread_mutex_init(&async->lock, NULL);
+
+  if (pthread_create(&async->thread, NULL, loader_async_run, async) != 0) {
+    printf("[loader] unable to start loading thread, loading %s now\n", fn);
+    loader_async_run(async);
+    async->thread = pthread_self();
+  }
+  return async;
+}
+
+gsmodel*
+loader_async_model(loader_async* async) {
+  return async->model;
+}
+
+loader_async_state
+loader_async_poll(loader_async* async) {
+  pthread_mutex_lock(&async->lock);
+  loader_async_state state = async->state;
+  if (async->loading) {
+    /* the thread keeps ownership of the arrays until loading is done */
+    *async->model = *async->loading;
+    async->model->n_points = async->n_ready;
+    if (state == LOADER_ASYNC_LOADING) {
+      async->model->mapping = NULL;
+      async->model->mapping_size = 0;
+    }
+  }
+  pthread_mutex_unlock(&async->lock);
+  return state;
+}
+
+gsmodel*
+loader_async_finish(loader_async* async) {
+  if (!pthread_equal(async->thread, pthread_self()))
+    pthread_join(async->thread, NULL);
+  loader_async_poll(async);
+
+  gsmodel* model = async->model;
+  if (async->state == LOADER_ASYNC_DONE) {
+    free((gsmodel*)async->loading);
+  } else {
+    free(model);
+    model = NULL;
+  }
+  pthread_mutex_destroy(&async->lock);
+  free(async->fn);
+  free(async);
+  return model;
+}
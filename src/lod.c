@@ -0,0 +1,333 @@
+#include <math.h>
+#include <splatc/lod.h>
+#include <splatc/quantize.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOD_MAX_OPACITY 0.99f /* alpha is clamped there when drawn anyway */
+#define LOD_JACOBI_SWEEPS 8
+
+/* a splat as weighted moments, the covariance as xx, xy, xz, yy, yz, zz */
+typedef struct {
+  vec3f mean;
+  float cov[6];
+  vec3f color;
+  float weight;
+  lod_box box;
+} lod_moments;
+
+typedef struct {
+  const gsmodel *model;
+  gslod *lod;
+  float *covs;    /* of each node, as in lod_moments */
+  float *weights; /* of each node */
+  int level;      /* being built */
+} lod_build_args;
+
+/* mean projected area of the ellipsoid of scale s, up to a constant */
+static inline float
+lod_area(vec3f s) {
+  return s.x * s.y + s.x * s.z + s.y * s.z;
+}
+
+/* moments of point i, weighted by how much it covers */
+static void
+lod_leaf_moments(const gsmodel *model, size_t i, lod_moments *m) {
+  const gsmodel_quantized *q = model->quantized;
+  vec3f p = q ? quantize_decode_position(q, i) : model->positions[i];
+  vec3f s = q ? quantize_decode_scale(q, i) : model->scales[i];
+  vec4f r = q ? quantize_decode_rotation(q, i) : model->rotations[i];
+  float opacity = q ? quantize_decode_opacity(q, i) : model->opacities[i];
+
+  /* R S S^T R^T */
+  mat3 R = quat_to_mat3(r);
+  float cov[3][3];
+  for (int k = 0; k < 3; ++k) {
+    for (int c = 0; c < 3; ++c) {
+      cov[k][c] = 0.f;
+      for (int j = 0; j < 3; ++j) {
+        cov[k][c] += R.vv[k][j] * R.vv[c][j] * s.v[j] * s.v[j];
+      }
+    }
+  }
+
+  m->mean = p;
+  m->cov[0] = cov[0][0];
+  m->cov[1] = cov[0][1];
+  m->cov[2] = cov[0][2];
+  m->cov[3] = cov[1][1];
+  m->cov[4] = cov[1][2];
+  m->cov[5] = cov[2][2];
+  m->color = q ? quantize_decode_color(q, i) : model->colors[i];
+  m->weight = opacity * lod_area(s);
+  for (int k = 0; k < 3; ++k) {
+    float extent = 3.f * sqrtf(cov[k][k]);
+    m->box.min.v[k] = p.v[k] - extent;
+    m->box.max.v[k] = p.v[k] + extent;
+  }
+}
+
+/* moments of child i of a node of args->level */
+static void
+lod_child_moments(const lod_build_args *args, size_t i, lod_moments *m) {
+  if (args->level == 1) {
+    lod_leaf_moments(args->model, i, m);
+    return;
+  }
+
+  const gslod *lod = args->lod;
+  size_t node = lod->level_offsets[args->level - 2] + i;
+  m->mean = lod->parents->positions[node];
+  for (int k = 0; k < 6; ++k) m->cov[k] = args->covs[6 * node + k];
+  m->color = lod->parents->colors[node];
+  m->weight = args->weights[node];
+  m->box = lod->boxes[node];
+}
+
+/*
+ * Eigenvalues and eigenvectors of the symmetric matrix a by cyclic Jacobi
+ * rotations. Column j of V belongs to eigenvalue j.
+ */
+static void
+lod_eigen(float a[3][3], float values[3], float V[3][3]) {
+  for (int k = 0; k < 3; ++k) {
+    for (int c = 0; c < 3; ++c) V[k][c] = k == c ? 1.f : 0.f;
+  }
+
+  for (int sweep = 0; sweep < LOD_JACOBI_SWEEPS; ++sweep) {
+    float off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    float diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+    if (off <= 1e-12f * diag) break;
+
+    for (int p = 0; p < 2; ++p) {
+      for (int q = p + 1; q < 3; ++q) {
+        if (a[p][q] == 0.f) continue;
+        float theta = (a[q][q] - a[p][p]) / (2.f * a[p][q]);
+        float t = (theta >= 0.f ? 1.f : -1.f) /
+                  (fabsf(theta) + sqrtf(theta * theta + 1.f));
+        float c = 1.f / sqrtf(t * t + 1.f);
+        float s = t * c;
+
+        /* a = J^T a J, V = V J with the rotation J in the (p, q) plane */
+        for (int k = 0; k < 3; ++k) {
+          float akp = a[k][p];
+          float akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < 3; ++k) {
+          float apk = a[p][k];
+          float aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < 3; ++k) {
+          float vkp = V[k][p];
+          float vkq = V[k][q];
+          V[k][p] = c * vkp - s * vkq;
+          V[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  for (int k = 0; k < 3; ++k) values[k] = a[k][k];
+}
+
+/* quaternion (w, x, y, z) of the rotation matrix R, as quat_to_mat3 */
+static vec4f
+lod_quat(float R[3][3]) {
+  float trace = R[0][0] + R[1][1] + R[2][2];
+  vec4f q;
+  if (trace > 0.f) {
+    float s = 2.f * sqrtf(trace + 1.f);
+    q = (vec4f){{0.25f * s, (R[2][1] - R[1][2]) / s, (R[0][2] - R[2][0]) / s,
+                 (R[1][0] - R[0][1]) / s}};
+  } else if (R[0][0] > R[1][1] && R[0][0] > R[2][2]) {
+    float s = 2.f * sqrtf(1.f + R[0][0] - R[1][1] - R[2][2]);
+    q = (vec4f){{(R[2][1] - R[1][2]) / s, 0.25f * s, (R[0][1] + R[1][0]) / s,
+                 (R[0][2] + R[2][0]) / s}};
+  } else if (R[1][1] > R[2][2]) {
+    float s = 2.f * sqrtf(1.f + R[1][1] - R[0][0] - R[2][2]);
+    q = (vec4f){{(R[0][2] - R[2][0]) / s, (R[0][1] + R[1][0]) / s, 0.25f * s,
+                 (R[1][2] + R[2][1]) / s}};
+  } else {
+    float s = 2.f * sqrtf(1.f + R[2][2] - R[0][0] - R[1][1]);
+    q = (vec4f){{(R[1][0] - R[0][1]) / s, (R[0][2] + R[2][0]) / s,
+                 (R[1][2] + R[2][1]) / s, 0.25f * s}};
+  }
+  return norm4(q);
+}
+
+/*
+ * Merges the children of the nodes [begin, end) of args->level. The weights
+ * W = sum w_i give the mean sum w_i mu_i / W and the covariance
+ * sum w_i (Sigma_i + d_i d_i^T) / W with d_i = mu_i - mean, which preserve the
+ * first two moments of the children. The opacity keeps the weight of the
+ * parent at W for the next level.
+ */
+static void
+lod_merge_nodes(void *arg, size_t chunk, size_t begin, size_t end) {
+  lod_build_args *args = arg;
+  gslod *lod = args->lod;
+  gsmodel *parents = lod->parents;
+  int level = args->level;
+  size_t first = lod->level_offsets[level - 1];
+  size_t n_children = level == 1 ? lod->n_points
+                                 : lod->level_offsets[level - 1] -
+                                       lod->level_offsets[level - 2];
+  (void)chunk;
+
+  for (size_t j = begin; j < end; ++j) {
+    size_t node = first + j;
+    size_t lo = j * LOD_FANOUT;
+    size_t hi = lo + LOD_FANOUT < n_children ? lo + LOD_FANOUT : n_children;
+
+    lod_moments children[LOD_FANOUT];
+    float weight = 0.f;
+    for (size_t i = lo; i < hi; ++i) {
+      lod_child_moments(args, i, &children[i - lo]);
+      weight += children[i - lo].weight;
+    }
+    /* invisible children still count, equally */
+    int uniform = weight <= 0.f;
+    if (uniform) weight = hi - lo;
+
+    vec3f mean = {{0.f, 0.f, 0.f}};
+    vec3f color = {{0.f, 0.f, 0.f}};
+    lod_box box = children[0].box;
+    for (size_t c = 0; c < hi - lo; ++c) {
+      const lod_moments *m = &children[c];
+      float w = (uniform ? 1.f : m->weight) / weight;
+      for (int k = 0; k < 3; ++k) {
+        mean.v[k] += w * m->mean.v[k];
+        color.v[k] += w * m->color.v[k];
+        box.min.v[k] = fminf(box.min.v[k], m->box.min.v[k]);
+        box.max.v[k] = fmaxf(box.max.v[k], m->box.max.v[k]);
+      }
+    }
+
+    float cov[3][3] = {{0.f}};
+    for (size_t c = 0; c < hi - lo; ++c) {
+      const lod_moments *m = &children[c];
+      float w = (uniform ? 1.f : m->weight) / weight;
+      vec3f d = sub3(m->mean, mean);
+      const float child[3][3] = {{m->cov[0], m->cov[1], m->cov[2]},
+                                 {m->cov[1], m->cov[3], m->cov[4]},
+                                 {m->cov[2], m->cov[4], m->cov[5]}};
+      for (int k = 0; k < 3; ++k) {
+        for (int l = 0; l < 3; ++l) {
+          cov[k][l] += w * (child[k][l] + d.v[k] * d.v[l]);
+        }
+      }
+    }
+    float *node_cov = args->covs + 6 * node;
+    node_cov[0] = cov[0][0];
+    node_cov[1] = cov[0][1];
+    node_cov[2] = cov[0][2];
+    node_cov[3] = cov[1][1];
+    node_cov[4] = cov[1][2];
+    node_cov[5] = cov[2][2];
+
+    /* cov = V diag(s^2) V^T, with V a rotation */
+    float values[3], V[3][3];
+    lod_eigen(cov, values, V);
+    float det = V[0][0] * (V[1][1] * V[2][2] - V[1][2] * V[2][1]) -
+                V[0][1] * (V[1][0] * V[2][2] - V[1][2] * V[2][0]) +
+                V[0][2] * (V[1][0] * V[2][1] - V[1][1] * V[2][0]);
+    if (det < 0.f) {
+      for (int k = 0; k < 3; ++k) V[k][2] = -V[k][2];
+    }
+    vec3f scale;
+    for (int k = 0; k < 3; ++k) scale.v[k] = sqrtf(fmaxf(values[k], 1e-12f));
+
+    float area = lod_area(scale);
+    parents->positions[node] = mean;
+    parents->colors[node] = color;
+    parents->opacities[node] =
+        fminf(LOD_MAX_OPACITY, area > 0.f && !uniform ? weight / area : 0.f);
+    parents->scales[node] = scale;
+    parents->rotations[node] = lod_quat(V);
+    args->weights[node] = uniform ? 0.f : weight;
+    lod->boxes[node] = box;
+  }
+}
+
+gslod *
+lod_build(const gsmodel *model, tpool *pool) {
+  size_t n = model->n_points;
+  if (n < 2) return NULL;
+
+  /* level sizes up to the root */
+  gslod *lod = calloc(1, sizeof(gslod));
+  if (!lod) return NULL;
+  size_t count = n;
+  while (count > 1 && lod->n_levels < LOD_MAX_LEVELS) {
+    count = (count + LOD_FANOUT - 1) / LOD_FANOUT;
+    lod->level_offsets[lod->n_levels + 1] =
+        lod->level_offsets[lod->n_levels] + count;
+    lod->n_levels += 1;
+  }
+  size_t n_nodes = lod->level_offsets[lod->n_levels];
+  lod->n_points = n;
+
+  gsmodel *parents = calloc(1, sizeof(gsmodel));
+  lod->parents = parents;
+  lod->boxes = calloc(n_nodes, sizeof(lod_box));
+  if (parents) {
+    parents->n_points = n_nodes;
+    parents->positions = calloc(n_nodes, sizeof(vec3f));
+    parents->colors = calloc(n_nodes, sizeof(vec3f));
+    parents->opacities = calloc(n_nodes, sizeof(float));
+    parents->scales = calloc(n_nodes, sizeof(vec3f));
+    parents->rotations = calloc(n_nodes, sizeof(vec4f));
+  }
+  lod_build_args args = {model, lod, calloc(6 * n_nodes, sizeof(float)),
+                         calloc(n_nodes, sizeof(float)), 0};
+  if (!parents || !lod->boxes || !parents->positions || !parents->colors ||
+      !parents->opacities || !parents->scales || !parents->rotations ||
+      !args.covs || !args.weights) {
+    printf("[lod] unable to allocate %zu nodes\n", n_nodes);
+    free(args.covs);
+    free(args.weights);
+    lod_destroy(lod);
+    return NULL;
+  }
+
+  size_t n_chunks = pool ? tpool_num_threads(pool) : 1;
+  for (args.level = 1; args.level <= lod->n_levels; ++args.level) {
+    size_t n_level = lod->level_offsets[args.level] -
+                     lod->level_offsets[args.level - 1];
+    tpool_parallel_for(pool, n_level, n_chunks, lod_merge_nodes, &args);
+  }
+  free(args.covs);
+  free(args.weights);
+
+  printf("[lod] built %d levels of %zu nodes over %zu points\n", lod->n_levels,
+         n_nodes, n);
+  return lod;
+}
+
+void
+lod_destroy(gslod *lod) {
+  if (!lod) return;
+  if (lod->parents) loader_gsmodel_destroy(lod->parents);
+  free(lod->boxes);
+  free(lod);
+}
+
+lod_state
+lod_node_state(const gslod *lod, size_t node, lod_state parent,
+               const mat4 *model_view, const bvh_frustum *frustum, float focal,
+               float threshold) {
+  if (parent != LOD_REFINED) return LOD_HIDDEN;
+
+  const lod_box *box = &lod->boxes[node];
+  vec3f c, e;
+  bvh_box_to_view(box->min, box->max, model_view, &c, &e);
+  if (!bvh_view_box_visible(c, e, frustum)) return LOD_HIDDEN;
+
+  /* projected diameter of the bounding sphere of the box */
+  float radius = sqrtf(dot3(e, e));
+  if (c.z <= radius) return LOD_REFINED;
+  return 2.f * radius * focal < threshold * c.z ? LOD_DRAWN : LOD_REFINED;
+}
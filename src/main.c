@@ -6,6 +6,8 @@
 #include <splatc/loader.h>
 #include <splatc/ppm.h>
 #include <splatc/rasterizer.h>
+#include <splatc/scene.h>
+#include <splatc/stream.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,6 +23,8 @@
 
 #define TILESIZE 8
 
+#define IDLE_LOAD_POLL 0.05 /* seconds between polls of a load with no news */
+
 typedef enum {
   INPUT_W = (1 << 0),
   INPUT_A = (1 << 1),
@@ -33,6 +37,20 @@ typedef enum {
   INPUT_MB1 = (1 << 17),
 } key_state;
 
+/* what the rendered image depends on, to tell when it can be reused */
+typedef struct {
+  vec3f pos;
+  vec3f at;
+  float fovy;
+  float aspect;
+  float near;
+  float far;
+  const gsmodel *model; /* NULL for scenes, which do not change */
+  long n_points;
+  int loading;
+  size_t n_stream_changes; /* chunks paged in or out so far */
+} view_state;
+
 typedef struct {
   uint32_t key_input;
   uint32_t key_input_pressed;
@@ -153,6 +171,35 @@ update_view(camera *cam, window_state *ws) {
   cam->at.z += dot3(offset_pos, cam->forward);
 }
 
+static view_state
+view_state_get(const camera *cam, const gsmodel *model,
+               const loader_async *loading, const gsstream *stream) {
+  view_state state = {.pos = cam->pos,
+                      .at = cam->at,
+                      .fovy = cam->fovy,
+                      .aspect = cam->aspect,
+                      .near = cam->near,
+                      .far = cam->far,
+                      .model = model,
+                      .n_points = model ? model->n_points : 0,
+                      .loading = loading != NULL};
+  if (stream) {
+    stream_stats stats = stream_get_stats(stream);
+    state.n_stream_changes = stats.n_loaded + stats.n_evicted;
+  }
+  return state;
+}
+
+static int
+view_state_equal(const view_state *a, const view_state *b) {
+  return a->pos.x == b->pos.x && a->pos.y == b->pos.y &&
+         a->pos.z == b->pos.z && a->at.x == b->at.x && a->at.y == b->at.y &&
+         a->at.z == b->at.z && a->fovy == b->fovy && a->aspect == b->aspect &&
+         a->near == b->near && a->far == b->far && a->model == b->model &&
+         a->n_points == b->n_points && a->loading == b->loading &&
+         a->n_stream_changes == b->n_stream_changes;
+}
+
 void
 image_save(frame *frame) {
   ppm_write((float*)frame->pixels, WIDTH, HEIGHT, "render.ppm");
@@ -165,9 +212,90 @@ main(int ac, const char **av) {
   }
 
   /* load gsmodel */
-  gsmodel *model = loader_gsmodel_from_ply(av[1]);
-  // gsmodel *model = loader_gsmodel_debug();
-  if (!model) return -1;
+  loader_options load_opts = {.n_threads = LOADER_DEFAULT_THREADS,
+                               .cache = LOADER_CACHE_AUTO};
+  const char *chunks_fn = NULL;
+  size_t stream_budget = 0;
+  int load_scene = 0;
+  rasterizer_sort_mode sort_mode = RASTERIZER_SORT_DEPTH;
+  float lod_threshold = 0.f;
+  int n_load_flags = 0; /* options that only apply to loaded models */
+  for (int a = 2; a < ac; ++a) {
+    if (strcmp(av[a], "--quantize") == 0) {
+      load_opts.quantize = 1;
+      n_load_flags++;
+    } else if (strcmp(av[a], "--prune") == 0) {
+      load_opts.prune_opacity = LOADER_PRUNE_OPACITY;
+      n_load_flags++;
+    } else if (strcmp(av[a], "--prune-scale") == 0 && a + 1 < ac) {
+      load_opts.prune_scale = strtof(av[++a], NULL);
+      n_load_flags++;
+    } else if (strcmp(av[a], "--reorder") == 0) {
+      load_opts.reorder = LOADER_REORDER_MORTON;
+      n_load_flags++;
+    } else if (strcmp(av[a], "--bvh") == 0) {
+      load_opts.build_bvh = 1;
+      n_load_flags++;
+    } else if (strcmp(av[a], "--lod") == 0 && a + 1 < ac) {
+      load_opts.build_lod = 1;
+      lod_threshold = strtof(av[++a], NULL);
+      n_load_flags++;
+    } else if (strcmp(av[a], "--write-chunks") == 0 && a + 1 < ac) {
+      chunks_fn = av[++a];
+      n_load_flags++;
+    } else if (strcmp(av[a], "--stream") == 0 && a + 1 < ac) {
+      stream_budget = (size_t)strtoull(av[++a], NULL, 10) << 20; /* MiB */
+    } else if (strcmp(av[a], "--scene") == 0) {
+      load_scene = 1;
+    } else if (strcmp(av[a], "--tile-sort") == 0) {
+      sort_mode = RASTERIZER_SORT_TILE;
+    } else if (strcmp(av[a], "--incremental-sort") == 0) {
+      sort_mode = RASTERIZER_SORT_INCREMENTAL;
+    } else {
+      printf("unknown option %s\n", av[a]);
+      return -1;
+    }
+  }
+  if (stream_budget && n_load_flags > 0) {
+    printf("--stream can not be combined with other options\n");
+    return -1;
+  }
+  if (load_scene && (stream_budget || chunks_fn)) {
+    printf("--scene can not be combined with --stream or --write-chunks\n");
+    return -1;
+  }
+
+  /* bake the model into spatial chunks for --stream */
+  if (chunks_fn) {
+    gsmodel *model = loader_gsmodel_load(av[1], &load_opts);
+    if (!model) return -1;
+    int ok = loader_gsmodel_write_splatc_chunked(model, chunks_fn,
+                                                 STREAM_DEFAULT_CHUNK_SIZE);
+    if (!ok) printf("unable to write chunks to %s\n", chunks_fn);
+    loader_gsmodel_destroy(model);
+    return ok ? 0 : -1;
+  }
+
+  /*
+   * Stream a chunked .splatc file, load a scene of several models, or load the
+   * model in the background and render it while it fills in.
+   */
+  gsstream *stream = NULL;
+  loader_async *loading = NULL;
+  gsscene *scene = NULL;
+  gsmodel *model = NULL;
+  if (stream_budget) {
+    stream = stream_open(av[1], stream_budget);
+    if (!stream) return -1;
+    model = stream_model(stream);
+  } else if (load_scene) {
+    scene = scene_load(av[1], &load_opts);
+    if (!scene) return -1;
+  } else {
+    loading = loader_gsmodel_load_async(av[1], &load_opts);
+    model = loader_async_model(loading);
+    // model = loader_gsmodel_debug();
+  }
 
   /* create window */
   GLFWwindow *window;
@@ -215,12 +343,18 @@ main(int ac, const char **av) {
 
   /* Create rasterizer context */
   vec2u tile_size = {TILESIZE, TILESIZE};
-  raster_ctx *ctx = rasterizer_context_create(model, image, tile_size);
+  raster_ctx *ctx =
+      scene ? rasterizer_context_create_scene(scene, image, tile_size)
+            : rasterizer_context_create(model, image, tile_size);
+  rasterizer_set_sort_mode(ctx, sort_mode);
+  rasterizer_set_lod_threshold(ctx, lod_threshold);
 
   size_t frame_no = 0;
   clock_t start, end, frame_start, frame_end;
-  double trans_time, render_time, frame_time;
+  double trans_time = 0, render_time = 0, frame_time;
   double fps = 0;
+  view_state drawn = {0}; /* that the image was rendered for */
+  int has_image = 0;      /* nothing drawn yet while 0 */
 
   while (!glfwWindowShouldClose(window)) {
     frame_start = clock();
@@ -228,32 +362,69 @@ main(int ac, const char **av) {
 
     /* Update view */
     update_view(&cam, &window_state);
-    start = clock();
-    rasterizer_preprocess(ctx, &cam, image);
-    end = clock();
-    trans_time = ((double)(end - start)) / CLOCKS_PER_SEC;
-
-    /* Draw frame */
-    start = clock();
-    rasterizer_frame_clear(image);
-    rasterizer_render(ctx, &cam, image);
+    if (stream) stream_update(stream, &cam);
+    if (loading) {
+      loader_async_state state = loader_async_poll(loading);
+      if (state != LOADER_ASYNC_LOADING) {
+        model = loader_async_finish(loading);
+        loading = NULL;
+        if (!model) break;
+      }
+    }
+
+    /* Render only if the image would change, else present it again */
+    view_state state = view_state_get(&cam, model, loading, stream);
+    int redraw = !has_image || !view_state_equal(&state, &drawn);
+    if (redraw) {
+      start = clock();
+      rasterizer_preprocess(ctx, &cam, image);
+      end = clock();
+      trans_time = ((double)(end - start)) / CLOCKS_PER_SEC;
+
+      /* Draw frame */
+      start = clock();
+      rasterizer_frame_clear(image);
+      rasterizer_render(ctx, &cam, image);
+      end = clock();
+      render_time = ((double)(end - start)) / CLOCKS_PER_SEC;
+      drawn = state;
+      has_image = 1;
+    }
     glDrawPixels(image->width, image->height, GL_RGB, GL_FLOAT, image->pixels);
-    end = clock();
-    render_time = ((double)(end - start)) / CLOCKS_PER_SEC;
 
     /* Swap front and back buffers */
     glfwSwapBuffers(window);
 
-    /* Poll for and process events */
-    glfwPollEvents();
+    /* Poll for and process events, sleep until the next one while idle */
+    if (redraw) {
+      glfwPollEvents();
+    } else if (loading) {
+      glfwWaitEventsTimeout(IDLE_LOAD_POLL);
+    } else {
+      glfwWaitEvents();
+    }
 
-    /* Update FPS */
+    /* Update FPS of the rendered frames */
     frame_end = clock();
     frame_time = ((double)(frame_end - frame_start)) / CLOCKS_PER_SEC;
-    fps = fps * 0.5 + (1.f / frame_time) * 0.5;
+    if (redraw) fps = fps * 0.5 + (1.f / frame_time) * 0.5;
     if (frame_no % 10 == 0) {
-      snprintf(window_title, 128, "splat.c | %.1f (%.3f / %.3f)", fps,
-               trans_time, render_time);
+      int len = snprintf(window_title, 128, "splat.c | %.1f (%.3f / %.3f)",
+                         fps, trans_time, render_time);
+      if (loading) {
+        snprintf(window_title + len, 128 - len, " | loading, %ld pts",
+                 model->n_points);
+      } else if (stream) {
+        stream_stats stats = stream_get_stats(stream);
+        size_t requests = stats.n_requests ? stats.n_requests : 1;
+        snprintf(window_title + len, 128 - len,
+                 " | %ld pts, hit %.1f%%, %.1f MiB read", model->n_points,
+                 100.0 * stats.n_hits / requests,
+                 stats.bytes_read / (1024.0 * 1024.0));
+      } else if (scene) {
+        snprintf(window_title + len, 128 - len, " | %zu instances, %zu pts",
+                 scene->n_instances, scene_num_points(scene));
+      }
       glfwSetWindowTitle(window, window_title);
     }
 
@@ -268,10 +439,21 @@ main(int ac, const char **av) {
 
   glfwTerminate();
 
+  rasterizer_stats stats = rasterizer_get_stats(ctx);
+  printf("Peak of %zu tile-splat pairs in %.1f MiB\n", stats.n_pairs_peak,
+         stats.visibility_bytes_peak / (1024.0 * 1024.0));
+
   /* cleanup */
   rasterizer_context_destroy(ctx);
   rasterizer_frame_destroy(image);
-  loader_gsmodel_destroy(model);
+  if (loading) model = loader_async_finish(loading);
+  if (stream) {
+    stream_close(stream);
+  } else if (scene) {
+    scene_destroy(scene);
+  } else if (model) {
+    loader_gsmodel_destroy(model);
+  }
 
   return 0;
 }
@@ -0,0 +1,217 @@
+#include <math.h>
+#include <splatc/project.h>
+
+/*
+ * The kernels are written as loops over the lanes of a batch, which the
+ * compiler vectorizes. Each instruction set gets its own copy of them.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROJECT_X86
+#define PROJECT_INLINE static inline __attribute__((always_inline))
+#define PROJECT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PROJECT_INLINE static inline
+#endif
+
+#define N PROJECT_BATCH_SIZE
+
+PROJECT_INLINE void
+project_points_lanes(project_points *batch, const mat4 *model_view,
+                     const project_params *params) {
+  const mat4 MV = *model_view;
+  const mat4 P = params->proj;
+  const float width = params->width;
+  const float height = params->height;
+
+  for (int l = 0; l < N; ++l) {
+    float x = batch->position[0][l];
+    float y = batch->position[1][l];
+    float z = batch->position[2][l];
+
+    float view[4], clip[4];
+    for (int c = 0; c < 4; ++c) {
+      view[c] = x * MV.vv[0][c] + y * MV.vv[1][c] + z * MV.vv[2][c] +
+                MV.vv[3][c];
+    }
+    for (int c = 0; c < 4; ++c) {
+      clip[c] = view[0] * P.vv[0][c] + view[1] * P.vv[1][c] +
+                view[2] * P.vv[2][c] + view[3] * P.vv[3][c];
+    }
+
+    float rw = 1.f / (clip[3] + 1e-5f);
+    float ndc_x = clip[0] * rw;
+    float ndc_y = clip[1] * rw;
+    float ndc_z = clip[2] * rw;
+
+    for (int c = 0; c < 4; ++c) batch->view[c][l] = view[c];
+    batch->screen[0][l] = (0.5f * ndc_x + 0.5f) * width;
+    batch->screen[1][l] = (0.5f * ndc_y + 0.5f) * height;
+    batch->visible[l] = view[2] >= 0.f && ndc_x >= -1.f && ndc_x <= 1.f &&
+                        ndc_y >= -1.f && ndc_y <= 1.f && ndc_z >= -1.f &&
+                        ndc_z <= 1.f;
+  }
+}
+
+/*
+ * Projects the 3D covariance R S S^T R^T into screen space. Only the first two
+ * rows of the Jacobian are non-zero, so the projection is carried out as the
+ * 2x3 product M = J W R S and the result is M M^T. The 2D covariance is
+ * low-pass filtered and inverted. The splat is drawn within the 3 sigma square
+ * of its major axis where its alpha reaches params->min_alpha, an ellipse, and
+ * the extent bounds both.
+ */
+PROJECT_INLINE void
+project_splats_lanes(project_splats *batch, const project_params *params) {
+  const float limx = 1.3f * params->tan_fovx;
+  const float limy = 1.3f * params->tan_fovy;
+  const float focal_x = params->focal_x;
+  const float focal_y = params->focal_y;
+  const float width = params->width;
+  const float height = params->height;
+  const float min_alpha = params->min_alpha;
+
+  for (int l = 0; l < N; ++l) {
+    float tz = batch->view[2][l];
+    float tx = fminf(limx, fmaxf(-limx, batch->view[0][l] / tz)) * tz;
+    float ty = fminf(limy, fmaxf(-limy, batch->view[1][l] / tz)) * tz;
+
+    const float rz = 1.f / tz;
+    const float j00 = focal_x * rz;
+    const float j02 = -focal_x * tx * rz * rz;
+    const float j11 = focal_y * rz;
+    const float j12 = -focal_y * ty * rz * rz;
+
+    /* T = J W */
+    float T0[3], T1[3];
+    for (int c = 0; c < 3; ++c) {
+      T0[c] = j00 * batch->W[c][l] + j02 * batch->W[6 + c][l];
+      T1[c] = j11 * batch->W[3 + c][l] + j12 * batch->W[6 + c][l];
+    }
+
+    /* R of the quaternion, as quat_to_mat3 */
+    float r = batch->rotation[0][l];
+    float x = batch->rotation[1][l];
+    float y = batch->rotation[2][l];
+    float z = batch->rotation[3][l];
+    float R[3][3] = {
+        {1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z),
+         2.f * (x * z + r * y)},
+        {2.f * (x * y + r * z), 1.f - 2.f * (x * x + z * z),
+         2.f * (y * z - r * x)},
+        {2.f * (x * z - r * y), 2.f * (y * z + r * x),
+         1.f - 2.f * (x * x + y * y)},
+    };
+
+    /* M = T R S */
+    float M0[3], M1[3];
+    for (int c = 0; c < 3; ++c) {
+      float s = batch->scale[c][l];
+      M0[c] = (T0[0] * R[0][c] + T0[1] * R[1][c] + T0[2] * R[2][c]) * s;
+      M1[c] = (T1[0] * R[0][c] + T1[1] * R[1][c] + T1[2] * R[2][c]) * s;
+    }
+
+    const float h_var = 0.3f;
+    float a = M0[0] * M0[0] + M0[1] * M0[1] + M0[2] * M0[2] + h_var;
+    float b = M0[0] * M1[0] + M0[1] * M1[1] + M0[2] * M1[2];
+    float c = M1[0] * M1[0] + M1[1] * M1[1] + M1[2] * M1[2] + h_var;
+    float det = a * c - b * b;
+    float det_inv = det == 0.f ? 0.f : 1.f / det;
+
+    float mid = 0.5f * (a + c);
+    float lambda = mid + sqrtf(fmaxf(0.1f, mid * mid - det));
+    float radius = ceilf(3.f * sqrtf(lambda));
+
+    /* alpha = opacity / (1 + x + 0.48 x^2) at x = -power, see render_kernel */
+    float o = batch->opacity[l] / min_alpha;
+    float cutoff = (sqrtf(fmaxf(1.f + 1.92f * (o - 1.f), 1.f)) - 1.f) / 0.96f;
+    cutoff = det == 0.f || radius < 1.f || o < 1.f ? 0.f : cutoff;
+
+    /* the ellipse d^T conic d = 2 cutoff spans sqrt(2 cutoff cov_xx) in x */
+    float ex = fminf(radius, sqrtf(2.f * cutoff * a));
+    float ey = fminf(radius, sqrtf(2.f * cutoff * c));
+    float px = batch->screen[0][l];
+    float py = batch->screen[1][l];
+    batch->conic[0][l] = c * det_inv;
+    batch->conic[1][l] = -b * det_inv;
+    batch->conic[2][l] = a * det_inv;
+    batch->cutoff[l] = cutoff;
+    batch->extent[0][l] = ex;
+    batch->extent[1][l] = ey;
+    batch->rect[0][l] = fmaxf(floorf(px - ex), 0.f);
+    batch->rect[1][l] = fmaxf(floorf(py - ey), 0.f);
+    batch->rect[2][l] = fminf(px + ex + 1.f, width);
+    batch->rect[3][l] = fminf(py + ey + 1.f, height);
+  }
+}
+
+static void
+project_points_scalar(project_points *batch, const mat4 *model_view,
+                      const project_params *params) {
+  project_points_lanes(batch, model_view, params);
+}
+
+static void
+project_splats_scalar(project_splats *batch, const project_params *params) {
+  project_splats_lanes(batch, params);
+}
+
+#ifdef PROJECT_X86
+PROJECT_TARGET("sse4.1")
+static void
+project_points_sse4(project_points *batch, const mat4 *model_view,
+                    const project_params *params) {
+  project_points_lanes(batch, model_view, params);
+}
+
+PROJECT_TARGET("sse4.1")
+static void
+project_splats_sse4(project_splats *batch, const project_params *params) {
+  project_splats_lanes(batch, params);
+}
+
+PROJECT_TARGET("avx2,fma")
+static void
+project_points_avx2(project_points *batch, const mat4 *model_view,
+                    const project_params *params) {
+  project_points_lanes(batch, model_view, params);
+}
+
+PROJECT_TARGET("avx2,fma")
+static void
+project_splats_avx2(project_splats *batch, const project_params *params) {
+  project_splats_lanes(batch, params);
+}
+
+PROJECT_TARGET("avx512f,fma,prefer-vector-width=512")
+static void
+project_points_avx512(project_points *batch, const mat4 *model_view,
+                      const project_params *params) {
+  project_points_lanes(batch, model_view, params);
+}
+
+PROJECT_TARGET("avx512f,fma,prefer-vector-width=512")
+static void
+project_splats_avx512(project_splats *batch, const project_params *params) {
+  project_splats_lanes(batch, params);
+}
+#endif
+
+project_kernels
+project_get_kernels(cpu_isa isa) {
+#ifdef PROJECT_X86
+  switch (isa) {
+    case CPU_ISA_AVX512:
+      return (project_kernels){isa, project_points_avx512,
+                               project_splats_avx512};
+    case CPU_ISA_AVX2:
+      return (project_kernels){isa, project_points_avx2, project_splats_avx2};
+    case CPU_ISA_SSE4:
+      return (project_kernels){isa, project_points_sse4, project_splats_sse4};
+    default:
+      break;
+  }
+#endif
+  (void)isa;
+  return (project_kernels){CPU_ISA_SCALAR, project_points_scalar,
+                           project_splats_scalar};
+}
@@ -0,0 +1,253 @@
+#include <math.h>
+#include <splatc/quantize.h>
+#include <splatc/sh.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define QUANTIZE_HALF_TARGET 16384.f /* largest scale after scaling */
+
+/* largest decode errors seen, in the units of gsmodel_quantized */
+typedef struct {
+  float position;
+  float color;
+  float opacity;
+  float scale;
+  float rotation;
+  float sh;
+} quantize_errors;
+
+typedef struct {
+  const gsmodel *model;
+  gsmodel_quantized *q;
+  size_t sh_values;        /* floats per point */
+  quantize_errors *errors; /* one per task */
+} quantize_args;
+
+uint16_t
+quantize_float_to_half(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t f_exp = (bits >> 23) & 0xFF;
+  uint32_t mant = bits & 0x7FFFFF;
+  int32_t exp = (int32_t)f_exp - 127 + 15;
+
+  if (f_exp == 0xFF) return sign | 0x7C00 | (mant ? 0x200 : 0);
+  if (exp >= 31) return sign | 0x7BFF; /* clamp to the largest finite half */
+
+  if (exp <= 0) {
+    /* subnormal half, round to nearest even in units of 2^-24 */
+    if (exp < -10) return sign;
+    mant |= 0x800000;
+    uint32_t shift = 14 - exp;
+    uint32_t h = mant >> shift;
+    uint32_t rem = mant & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (h & 1))) h++;
+    return sign | h;
+  }
+
+  uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+  uint32_t rem = mant & 0x1FFF;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+  if (h >= 0x7C00) h = 0x7BFF;
+  return sign | h;
+}
+
+static uint8_t
+quantize_unorm8(float v) {
+  v = fminf(fmaxf(v, 0.f), 255.f);
+  return (uint8_t)(v + 0.5f);
+}
+
+/* smallest three encoding, the largest component is recovered from |q| = 1 */
+static uint32_t
+quantize_rotation(vec4f q) {
+  uint32_t largest = 0;
+  for (uint32_t j = 1; j < 4; ++j) {
+    if (fabsf(q.v[j]) > fabsf(q.v[largest])) largest = j;
+  }
+  float sign = q.v[largest] < 0.f ? -1.f : 1.f;
+
+  uint32_t packed = largest << 30;
+  for (uint32_t j = 0, k = 0; j < 4; ++j) {
+    if (j == largest) continue;
+    float t = sign * q.v[j] / QUANTIZE_SQRT2 + 0.5f;
+    float v = fminf(fmaxf(t, 0.f), 1.f) * QUANTIZE_ROTATION_MAX + 0.5f;
+    packed |= (uint32_t)v << (20 - 10 * k++);
+  }
+  return packed;
+}
+
+static float
+quantize_relative_error(float decoded, float value) {
+  return value != 0.f ? fabsf(decoded - value) / fabsf(value) : fabsf(decoded);
+}
+
+/* decodes point i and grows e by its errors */
+static void
+quantize_measure(const gsmodel *model, const gsmodel_quantized *q,
+                 size_t sh_values, size_t i, quantize_errors *e) {
+  vec3f position = quantize_decode_position(q, i);
+  vec3f color = quantize_decode_color(q, i);
+  vec3f scale = quantize_decode_scale(q, i);
+  for (int j = 0; j < 3; ++j) {
+    e->position =
+        fmaxf(e->position, fabsf(position.v[j] - model->positions[i].v[j]));
+    e->color = fmaxf(e->color, fabsf(color.v[j] - model->colors[i].v[j]));
+    e->scale = fmaxf(e->scale, quantize_relative_error(
+                                   scale.v[j], model->scales[i].v[j]));
+  }
+  e->opacity = fmaxf(e->opacity, fabsf(quantize_decode_opacity(q, i) -
+                                       model->opacities[i]));
+
+  /* q and -q are the same rotation, the decoded largest one is positive */
+  vec4f rotation = quantize_decode_rotation(q, i);
+  vec4f original = model->rotations[i];
+  uint32_t largest = q->rotations[i] >> 30;
+  float sign = original.v[largest] < 0.f ? -1.f : 1.f;
+  for (int j = 0; j < 4; ++j) {
+    e->rotation =
+        fmaxf(e->rotation, fabsf(rotation.v[j] - sign * original.v[j]));
+  }
+
+  for (size_t j = 0; j < sh_values; ++j) {
+    float decoded = quantize_half_to_float(q->sh[i * sh_values + j]);
+    e->sh = fmaxf(e->sh, fabsf(decoded - model->sh[i * sh_values + j]));
+  }
+}
+
+static void
+quantize_chunk_range(void *arg, size_t task, size_t begin, size_t end) {
+  quantize_args *args = arg;
+  const gsmodel *model = args->model;
+  gsmodel_quantized *q = args->q;
+  quantize_errors *errors = &args->errors[task];
+
+  for (size_t c = begin; c < end; ++c) {
+    size_t first = c * QUANTIZE_CHUNK_SIZE;
+    size_t last = first + QUANTIZE_CHUNK_SIZE;
+    if (last > (size_t)model->n_points) last = model->n_points;
+
+    vec3f min = model->positions[first];
+    vec3f max = min;
+    for (size_t i = first; i < last; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        min.v[j] = fminf(min.v[j], model->positions[i].v[j]);
+        max.v[j] = fmaxf(max.v[j], model->positions[i].v[j]);
+      }
+    }
+
+    quantized_chunk *chunk = &q->chunks[c];
+    chunk->min = min;
+    for (int j = 0; j < 3; ++j) {
+      chunk->step.v[j] = (max.v[j] - min.v[j]) / 65535.f;
+    }
+
+    for (size_t i = first; i < last; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        float t = chunk->step.v[j] > 0.f
+                      ? (model->positions[i].v[j] - min.v[j]) / chunk->step.v[j]
+                      : 0.f;
+        q->positions[3 * i + j] = (uint16_t)fminf(t + 0.5f, 65535.f);
+      }
+
+      for (int j = 0; j < 3; ++j) {
+        q->colors[4 * i + j] = quantize_unorm8(
+            (model->colors[i].v[j] - q->color_min) / q->color_step);
+      }
+      q->colors[4 * i + 3] = quantize_unorm8(model->opacities[i] * 255.f);
+
+      for (int j = 0; j < 3; ++j) {
+        q->scales[3 * i + j] =
+            quantize_float_to_half(model->scales[i].v[j] * q->scale_mult);
+      }
+      q->rotations[i] = quantize_rotation(model->rotations[i]);
+
+      for (size_t j = 0; j < args->sh_values; ++j) {
+        q->sh[i * args->sh_values + j] =
+            quantize_float_to_half(model->sh[i * args->sh_values + j]);
+      }
+
+      quantize_measure(model, q, args->sh_values, i, errors);
+    }
+  }
+}
+
+gsmodel_quantized *
+quantize_gsmodel(const gsmodel *model, tpool *pool) {
+  if (model->quantized || model->n_points <= 0) return NULL;
+
+  size_t n = model->n_points;
+  size_t sh_values = model->sh ? 3 * sh_num_coeffs(model->sh_degree) : 0;
+  size_t n_chunks = (n + QUANTIZE_CHUNK_SIZE - 1) / QUANTIZE_CHUNK_SIZE;
+
+  gsmodel_quantized *q = calloc(1, sizeof(gsmodel_quantized));
+  q->chunks = calloc(n_chunks, sizeof(quantized_chunk));
+  q->positions = calloc(3 * n, sizeof(uint16_t));
+  q->colors = calloc(4 * n, sizeof(uint8_t));
+  q->scales = calloc(3 * n, sizeof(uint16_t));
+  q->rotations = calloc(n, sizeof(uint32_t));
+  if (sh_values) q->sh = calloc(sh_values * n, sizeof(uint16_t));
+
+  /* global ranges for colors and scales */
+  float color_min = INFINITY, color_max = -INFINITY, scale_max = 0.f;
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      color_min = fminf(color_min, model->colors[i].v[j]);
+      color_max = fmaxf(color_max, model->colors[i].v[j]);
+      scale_max = fmaxf(scale_max, fabsf(model->scales[i].v[j]));
+    }
+  }
+
+  q->color_min = color_min;
+  q->color_step = color_max > color_min ? (color_max - color_min) / 255.f : 1.f;
+  /* power of two factor that moves small scales into the normal half range */
+  q->scale_mult =
+      scale_max > 0.f ? exp2f(floorf(log2f(QUANTIZE_HALF_TARGET / scale_max)))
+                      : 1.f;
+
+  size_t n_tasks = 4 * tpool_num_threads(pool);
+  if (n_tasks > n_chunks) n_tasks = n_chunks;
+  quantize_args args = {model, q, sh_values,
+                        calloc(n_tasks, sizeof(quantize_errors))};
+  tpool_parallel_for(pool, n_chunks, n_tasks, quantize_chunk_range, &args);
+
+  for (size_t t = 0; t < n_tasks; ++t) {
+    const quantize_errors *e = &args.errors[t];
+    q->position_error = fmaxf(q->position_error, e->position);
+    q->color_error = fmaxf(q->color_error, e->color);
+    q->opacity_error = fmaxf(q->opacity_error, e->opacity);
+    q->scale_error = fmaxf(q->scale_error, e->scale);
+    q->rotation_error = fmaxf(q->rotation_error, e->rotation);
+    q->sh_error = fmaxf(q->sh_error, e->sh);
+  }
+  free(args.errors);
+
+  size_t float_size = 3 * sizeof(vec3f) + sizeof(float) + sizeof(vec4f) +
+                      sh_values * sizeof(float);
+  size_t quantized_size = 6 * sizeof(uint16_t) + 4 + sizeof(uint32_t) +
+                          sh_values * sizeof(uint16_t);
+  printf(
+      "[quantize] %zu -> %zu bytes per point (+%zu chunk bytes), max error: "
+      "position %.2e, color %.2e, opacity %.2e, scale %.1e (relative), "
+      "rotation %.1e, sh %.1e\n",
+      float_size, quantized_size, n_chunks * sizeof(quantized_chunk),
+      q->position_error, q->color_error, q->opacity_error, q->scale_error,
+      q->rotation_error, q->sh_error);
+
+  return q;
+}
+
+void
+quantize_destroy(gsmodel_quantized *q) {
+  if (!q) return;
+  free(q->chunks);
+  free(q->positions);
+  free(q->colors);
+  free(q->scales);
+  free(q->rotations);
+  free(q->sh);
+  free(q);
+}
@@ -1,22 +1,40 @@
 #include <assert.h>
+#include <splatc/blend.h>
+#include <splatc/bvh.h>
 #include <splatc/camera.h>
 #include <splatc/linalg.h>
 #include <splatc/loader.h>
+#include <splatc/lod.h>
+#include <splatc/project.h>
+#include <splatc/quantize.h>
 #include <splatc/rasterizer.h>
+#include <splatc/scene.h>
+#include <splatc/sh.h>
+#include <splatc/sort.h>
 #include <splatc/threadpool.h>
 #include <stdio.h>
 #include <string.h>
 
 #define RASTERIZER_NUM_THREADS 16
 #define RASTERIZER_TILE_BATCH_SIZE 32
+#define RASTERIZER_NUM_CHUNKS \
+  RASTERIZER_NUM_THREADS /* work items of each preprocess pass */
+
+#define RASTERIZER_NO_SLOT UINT32_MAX
+#define RASTERIZER_MAX_NEW_SPLATS \
+  4 /* full sort once more than 1/4 of the visible splats are new */
+#define RASTERIZER_MAX_SORT_SHIFTS \
+  32 /* moves per splat before the incremental sort gives up */
+#define RASTERIZER_MAX_SORT_BACKOFF \
+  16 /* frames the incremental sort waits at most after giving up */
+#define RASTERIZER_MIN_ALPHA 0.004f /* 1/255 ~= 0.004 */
+#define RASTERIZER_SHRINK_FRAMES \
+  120 /* default frames below 1/4 of the visibility buffers before a shrink */
 
 #define LOG2E 1.4426950408889634f
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
-#define AVG_TILES_TOUCHED_HEURISTIC \
-  45 /* used to preallocate memory for visibility buffer */
-
 struct render_kernel_args;
 
 typedef struct {
@@ -24,31 +42,107 @@ typedef struct {
   vec2u upper;
 } tile_range;
 
+/*
+ * The ellipse q(u, v) = A u^2 + 2 B u v + C v^2 <= 2 cutoff around the mean
+ * of a splat, with (A, B, C) its conic and cutoff as in project_splats, within
+ * which the render kernel draws it. Over a band of rows its largest u lies at
+ * the v of its rightmost point clamped to the band, and its smallest u at the
+ * v of its leftmost point.
+ */
+typedef struct {
+  float mean_x;      /* in tiles */
+  float mean_y;      /* in pixels */
+  float b, k2a, det; /* B, 2 cutoff A and AC - B^2 */
+  float scale;       /* 1 / A in tiles */
+  float v_extent;    /* v range of the ellipse */
+  float v_right;     /* v of its rightmost point, -v_right of its leftmost */
+  int full;          /* reaches its whole tile range */
+} splat_ellipse;
+
 typedef struct {
   vec4f view;
   vec2f frame;
-  size_t idx;
+  size_t idx;        /* index into the per-splat buffers */
+  uint32_t instance; /* instance the splat belongs to */
 } transformed_point;
 
+/* visible splats waiting for SH evaluation */
+typedef struct {
+  uint32_t idx[SH_BATCH_SIZE];
+  vec3f dirs[SH_BATCH_SIZE];
+  size_t size;
+} sh_batch;
+
+/* per-frame state of a scene instance */
+typedef struct {
+  const gsmodel *model;
+  const gslod *lod; /* if the level of detail is cut */
+  size_t offset;    /* of its splats in the per-splat buffers */
+  size_t n_splats;  /* its points followed by the nodes of lod */
+  mat4 model_view;
+  mat3 W;           /* rotational part of model_view */
+  vec3f camera_pos; /* in model space, for view-dependent colors */
+} instance_state;
+
 struct raster_ctx_t {
-  /* model */
-  gsmodel *model;
+  /* scene */
+  gsscene *scene;
+  int owns_scene; /* scene wraps a single model */
+  instance_state *instances;
+  size_t n_instances;
+  size_t capacity; /* points the per-splat buffers below can hold */
 
   /* rendering */
   transformed_point *trans_points;
-  vec4f *ndc_points;
+  /* visible splats in projection order */
+  transformed_point *sort_buffer;
+  /* depth keys, sort_buffer slots and sort scratch, 4 per splat */
+  uint32_t *sort_keys;
+  /* sort_buffer slot per splat or RASTERIZER_NO_SLOT */
+  uint32_t *splat_slots;
+  /* splats in the depth order of the last frame */
+  uint32_t *sorted_points;
+  size_t n_sorted;
+  /* frames left to sort by depth after the incremental sort gave up, and
+     how many it waited the last time, doubled each time it gives up in a row */
+  size_t sort_skip;
+  size_t sort_backoff;
   tile_range *tile_ranges;
+  splat_ellipse *ellipses; /* of the sorted splats, for binning */
+  blend_splat *records;    /* of the visible splats, for rendering */
   uint32_t *visibility_tile_counts;
   uint32_t *visibility_tile_offsets;
   uint32_t *visibility_tile_points;
-  float *radii;
-  vec3f *inv_cov2d;
+  size_t visibility_capacity;
+  size_t shrink_frames;  /* 0 never shrinks the visibility buffers */
+  size_t n_small_frames; /* in a row that used less than 1/4 of them */
+  rasterizer_stats stats;
+  vec3f *colors; /* per-instance colors, or the colors of a single model */
+  int owns_colors;
   vec2u tile_size;
   vec2u n_tiles;
-  vec3f *throughputs;
+  project_kernels kernels;
+  blend_kernels blend;
+  size_t tile_pixels; /* of the tile buffers, a multiple of BLEND_BATCH_SIZE */
+  float *tile_cols;   /* column of each pixel of a tile */
+  float *tile_rows;   /* row of each pixel of a tile */
+
+  /* level of detail */
+  float lod_threshold; /* in pixels, 0 draws all points */
+  uint8_t *lod_states; /* lod_state per node, at the index of its splat */
+
+  /* tile sort */
+  rasterizer_sort_mode sort_mode;
+  uint64_t *pair_keys;   /* tile << 32 | depth per binned splat, and scratch */
+  uint32_t *pair_values; /* scratch of the sort */
+  size_t pair_capacity;
 
   /* threading */
   tpool *tpool;
+  uint32_t *chunk_tile_counts; /* tile histogram of each binning chunk */
+  sh_batch *sh_batches;        /* one per chunk and instance */
+  /* per-chunk totals of a preprocess pass, then their prefix sum */
+  size_t chunk_offsets[RASTERIZER_NUM_CHUNKS + 1];
   size_t n_tile_batches;
   struct render_kernel_args *rargs;
 };
@@ -60,56 +154,85 @@ typedef struct render_kernel_args {
   size_t tile;
   size_t tile_start;
   size_t tile_end;
+  float *pixels; /* color and transmittance of the tile, see blend_tile */
 } render_batch_args;
 
-static inline float
-fast_exp_neg(float x) {
-  return 1.f / (1.f + x + 0.48f * x * x);
+/* per-frame parameters shared by the preprocess passes */
+typedef struct {
+  raster_ctx *ctx;
+  project_params params;
+  bvh_frustum frustum;
+  const uint32_t *order; /* sort_buffer slots of the visible splats */
+  size_t n_points;       /* of all instances */
+  size_t n_kept;         /* splats of the last order that stay visible */
+  const instance_state *lod_instance; /* whose hierarchy is being cut */
+  int lod_level;
+} preprocess_args;
+
+/*
+ * The model that holds splat i, which is a point of model or, past them, a node
+ * of its level of detail hierarchy. Moves i into that model.
+ */
+static inline const gsmodel *
+model_source(const gsmodel *model, size_t *i) {
+  if (*i < (size_t)model->n_points) return model;
+  *i -= model->n_points;
+  return model->lod->parents;
 }
 
-static vec2f
-frame_ndc_to_screen(vec4f p, frame *frame) {
-  return (vec2f){(0.5f * p.x + 0.5f) * frame->width,
-                 (0.5f * p.y + 0.5f) * frame->height};
+static inline vec3f
+model_position(const gsmodel *model, size_t i) {
+  model = model_source(model, &i);
+  if (model->quantized) return quantize_decode_position(model->quantized, i);
+  return model->positions[i];
 }
 
-static vec3f
-compute_cov2d(const vec4f *mu_view, const mat4 *view, mat3 *cov_3d,
-              float focal_x, float focal_y, float tan_fovx, float tan_fovy) {
-  vec3f t = {
-      mu_view->x,
-      mu_view->y,
-      mu_view->z,
-  };
-
-  const float limx = 1.3f * tan_fovx;
-  const float limy = 1.3f * tan_fovy;
-  const float txtz = t.x / t.z;
-  const float tytz = t.y / t.z;
-  t.x = fminf(limx, fmaxf(-limx, txtz)) * t.z;
-  t.y = fminf(limy, fmaxf(-limy, tytz)) * t.z;
-
-  mat3 J = {focal_x / t.z, 0.f,           -(focal_x * t.x) / (t.z * t.z),
-            0.f,           focal_y / t.z, -(focal_y * t.y) / (t.z * t.z),
-            0.f,           0.f,           0.f};
+static inline vec3f
+model_scale(const gsmodel *model, size_t i) {
+  model = model_source(model, &i);
+  if (model->quantized) return quantize_decode_scale(model->quantized, i);
+  return model->scales[i];
+}
 
-  mat3 W = {view->vv[0][0], view->vv[1][0], view->vv[2][0],
-            view->vv[0][1], view->vv[1][1], view->vv[2][1],
-            view->vv[0][2], view->vv[1][2], view->vv[2][2]};
+static inline vec4f
+model_rotation(const gsmodel *model, size_t i) {
+  model = model_source(model, &i);
+  if (model->quantized) return quantize_decode_rotation(model->quantized, i);
+  return model->rotations[i];
+}
 
-  mat3 T = matmul3(J, W);
-  mat3 Vrk = *cov_3d;
+static inline float
+model_opacity(const gsmodel *model, size_t i) {
+  model = model_source(model, &i);
+  if (model->quantized) return quantize_decode_opacity(model->quantized, i);
+  return model->opacities[i];
+}
 
-  mat3 cov = matmul3(T, matmul3(Vrk, transpose3(T)));
+/* the level of detail hierarchy of model if the context cuts it */
+static const gslod *
+rasterizer_model_lod(const raster_ctx *ctx, const gsmodel *model) {
+  const gslod *lod = model->lod;
+  if (ctx->lod_threshold <= 0.f || !lod) return NULL;
+  /* models that are still loading have outgrown their hierarchy */
+  return lod->n_points == (size_t)model->n_points ? lod : NULL;
+}
 
-  return (vec3f){cov.vv[0][0], cov.vv[0][1], cov.vv[1][1]};
+/* splats of model in the per-splat buffers */
+static size_t
+rasterizer_model_splats(const raster_ctx *ctx, const gsmodel *model) {
+  const gslod *lod = rasterizer_model_lod(ctx, model);
+  return model->n_points + (lod ? lod->level_offsets[lod->n_levels] : 0);
 }
 
-static int
-comp_points(const void *a, const void *b) {
-  float z0 = ((transformed_point *)b)->view.z;
-  float z1 = ((transformed_point *)a)->view.z;
-  return (z0 < z1) - (z0 > z1);
+static size_t
+rasterizer_num_splats(const raster_ctx *ctx) {
+  const gsscene *scene = ctx->scene;
+  size_t n = 0;
+  for (size_t i = 0; i < scene->n_instances; ++i) {
+    n += rasterizer_model_splats(ctx,
+                                 scene->models[scene->instances[i].model]);
+  }
+  return n;
 }
 
 frame *
@@ -135,21 +258,101 @@ rasterizer_frame_clear(frame *f) {
   // memset(f->pixels, 0, f->height * f->width * f->channels * sizeof(float));
 }
 
+/*
+ * Grows the per-splat buffers to hold the splats of all instances. Streamed and
+ * progressively loaded models change between frames, so this runs before every
+ * preprocess.
+ */
+static void
+rasterizer_reserve(raster_ctx *ctx) {
+  const gsscene *scene = ctx->scene;
+  size_t n_points = rasterizer_num_splats(ctx);
+
+  if (scene->n_instances != ctx->n_instances) {
+    free(ctx->instances);
+    free(ctx->sh_batches);
+    ctx->instances = calloc(scene->n_instances, sizeof(instance_state));
+    ctx->sh_batches = calloc(RASTERIZER_NUM_CHUNKS * scene->n_instances,
+                             sizeof(sh_batch));
+    ctx->n_instances = scene->n_instances;
+  }
+
+  if (n_points > ctx->capacity || !ctx->tile_ranges) {
+    if (ctx->tile_ranges) n_points = MAX(n_points, ctx->capacity * 3 / 2);
+
+    free(ctx->tile_ranges);
+    free(ctx->ellipses);
+    free(ctx->records);
+    free(ctx->trans_points);
+    free(ctx->sort_buffer);
+    free(ctx->sort_keys);
+    free(ctx->splat_slots);
+    free(ctx->sorted_points);
+    free(ctx->lod_states);
+
+    ctx->tile_ranges = calloc(n_points, sizeof(tile_range));
+    ctx->ellipses = calloc(n_points, sizeof(splat_ellipse));
+    ctx->records = calloc(n_points, sizeof(blend_splat));
+    ctx->trans_points = calloc(n_points, sizeof(transformed_point));
+    ctx->sort_buffer = calloc(n_points, sizeof(transformed_point));
+    ctx->sort_keys = calloc(4 * n_points, sizeof(uint32_t));
+    ctx->splat_slots = calloc(n_points, sizeof(uint32_t));
+    ctx->sorted_points = calloc(n_points, sizeof(uint32_t));
+    ctx->n_sorted = 0;
+    ctx->lod_states = calloc(n_points, sizeof(uint8_t));
+
+    if (ctx->owns_colors) free(ctx->colors);
+    ctx->owns_colors = 0;
+    ctx->capacity = n_points;
+  }
+
+  /*
+   * Colors alias a single model unless they have to be decoded or evaluated,
+   * or are followed by those of its hierarchy. Several instances always get
+   * their own copies.
+   */
+  int own_colors = scene->n_instances > 1;
+  for (size_t i = 0; i < scene->n_instances; ++i) {
+    const gsmodel *model = scene->models[scene->instances[i].model];
+    own_colors |= model->sh_degree > 0 || model->quantized ||
+                  rasterizer_model_lod(ctx, model) != NULL;
+  }
+
+  const gsmodel *model = scene->models[scene->instances[0].model];
+  if (own_colors && !ctx->owns_colors) {
+    ctx->colors = calloc(ctx->capacity, sizeof(vec3f));
+  } else if (!own_colors) {
+    if (ctx->owns_colors) free(ctx->colors);
+    ctx->colors = model->colors;
+  }
+  ctx->owns_colors = own_colors;
+}
+
 raster_ctx *
 rasterizer_context_create(gsmodel *model, frame *frame, vec2u tile_size) {
   assert(model != NULL);
 
+  gsscene *scene = scene_create();
+  scene_add_instance(scene, scene_add_model(scene, model), mat4_id());
+
+  raster_ctx *ctx = rasterizer_context_create_scene(scene, frame, tile_size);
+  ctx->owns_scene = 1;
+  return ctx;
+}
+
+raster_ctx *
+rasterizer_context_create_scene(gsscene *scene, frame *frame,
+                                vec2u tile_size) {
+  assert(scene != NULL && scene->n_instances > 0);
+
   raster_ctx *ctx = calloc(1, sizeof(raster_ctx));
 
-  ctx->model = model;
+  ctx->scene = scene;
 
   ctx->n_tiles = (vec2u){(frame->width + tile_size.x - 1) / tile_size.x,
                          (frame->height + tile_size.y - 1) / tile_size.y};
   ctx->tile_size = tile_size;
 
-  tile_range *tile_ranges = calloc(model->n_points, sizeof(tile_range));
-  ctx->tile_ranges = tile_ranges;
-
   uint32_t *visibility_tile_counts =
       calloc(ctx->n_tiles.x * ctx->n_tiles.y, sizeof(uint32_t));
   ctx->visibility_tile_counts = visibility_tile_counts;
@@ -158,29 +361,27 @@ rasterizer_context_create(gsmodel *model, frame *frame, vec2u tile_size) {
       calloc(ctx->n_tiles.x * ctx->n_tiles.y + 1, sizeof(uint32_t));
   ctx->visibility_tile_offsets = visibility_tile_offsets;
 
-  // TODO: realloc if actual points exceed the allocation here
-  uint32_t *visibility_tile_points =
-      calloc(model->n_points * AVG_TILES_TOUCHED_HEURISTIC, sizeof(uint32_t));
-  ctx->visibility_tile_points = visibility_tile_points;
-
-  vec4f *ndc_points = calloc(model->n_points, sizeof(vec4f));
-  ctx->ndc_points = ndc_points;
-
-  transformed_point *trans_points =
-      calloc(model->n_points, sizeof(transformed_point));
-  ctx->trans_points = trans_points;
+  ctx->chunk_tile_counts = calloc(RASTERIZER_NUM_CHUNKS * ctx->n_tiles.x *
+                                      ctx->n_tiles.y,
+                                  sizeof(uint32_t));
 
-  float *radii = calloc(model->n_points, sizeof(float));
-  ctx->radii = radii;
+  rasterizer_reserve(ctx);
 
-  vec3f *inv_cov2d = calloc(model->n_points, sizeof(vec3f));
-  ctx->inv_cov2d = inv_cov2d;
-
-  vec3f *throughputs = calloc(frame->height * frame->width, sizeof(vec3f));
-  ctx->throughputs = throughputs;
+  size_t tile_pixels = tile_size.x * tile_size.y;
+  ctx->tile_pixels = (tile_pixels + BLEND_BATCH_SIZE - 1) / BLEND_BATCH_SIZE *
+                     BLEND_BATCH_SIZE;
+  ctx->tile_cols = calloc(ctx->tile_pixels, sizeof(float));
+  ctx->tile_rows = calloc(ctx->tile_pixels, sizeof(float));
+  for (size_t i = 0; i < tile_pixels; ++i) {
+    ctx->tile_cols[i] = (float)(i % tile_size.x);
+    ctx->tile_rows[i] = (float)(i / tile_size.x);
+  }
 
   tpool *tpool = tpool_create(RASTERIZER_NUM_THREADS);
   ctx->tpool = tpool;
+  ctx->kernels = project_get_kernels(cpu_detect_isa());
+  ctx->blend = blend_get_kernels(cpu_detect_isa());
+  ctx->shrink_frames = RASTERIZER_SHRINK_FRAMES;
 
   ctx->n_tile_batches =
       ((ctx->n_tiles.x * ctx->n_tiles.y) + RASTERIZER_TILE_BATCH_SIZE - 1) /
@@ -193,88 +394,639 @@ rasterizer_context_create(gsmodel *model, frame *frame, vec2u tile_size) {
   return ctx;
 }
 
+void
+rasterizer_set_sort_mode(raster_ctx *ctx, rasterizer_sort_mode mode) {
+  ctx->sort_mode = mode;
+  ctx->n_sorted = 0;
+  ctx->sort_skip = 0;
+  ctx->sort_backoff = 0;
+}
+
+void
+rasterizer_set_lod_threshold(raster_ctx *ctx, float pixels) {
+  ctx->lod_threshold = pixels;
+  /* the splats move in the per-splat buffers */
+  ctx->n_sorted = 0;
+}
+
+void
+rasterizer_set_shrink_frames(raster_ctx *ctx, size_t n_frames) {
+  ctx->shrink_frames = n_frames;
+  ctx->n_small_frames = 0;
+}
+
+rasterizer_stats
+rasterizer_get_stats(const raster_ctx *ctx) {
+  return ctx->stats;
+}
+
+/*
+ * Sizes the visibility buffers for the n_pairs tile-splat pairs of a frame,
+ * along with the buffers of the tile sort if it is used. They grow by at least
+ * half and shrink back to 3/2 n_pairs once shrink_frames frames in a row used
+ * less than a quarter of them.
+ */
+static void
+rasterizer_reserve_visibility(raster_ctx *ctx, size_t n_pairs) {
+  size_t capacity = ctx->visibility_capacity;
+  if (n_pairs > capacity) {
+    capacity = MAX(n_pairs, capacity * 3 / 2);
+    ctx->n_small_frames = 0;
+  } else if (ctx->shrink_frames > 0 && n_pairs < capacity / 4) {
+    if (++ctx->n_small_frames >= ctx->shrink_frames) {
+      capacity = n_pairs * 3 / 2;
+      ctx->n_small_frames = 0;
+    }
+  } else {
+    ctx->n_small_frames = 0;
+  }
+
+  if (capacity != ctx->visibility_capacity) {
+    free(ctx->visibility_tile_points);
+    ctx->visibility_tile_points = calloc(capacity, sizeof(uint32_t));
+    ctx->visibility_capacity = capacity;
+  }
+
+  size_t pair_capacity = ctx->sort_mode == RASTERIZER_SORT_TILE ? capacity : 0;
+  if (pair_capacity != ctx->pair_capacity) {
+    free(ctx->pair_keys);
+    free(ctx->pair_values);
+    ctx->pair_keys = calloc(2 * pair_capacity, sizeof(uint64_t));
+    ctx->pair_values = calloc(pair_capacity, sizeof(uint32_t));
+    ctx->pair_capacity = pair_capacity;
+  }
+
+  rasterizer_stats *stats = &ctx->stats;
+  stats->n_pairs = n_pairs;
+  stats->n_pairs_peak = MAX(stats->n_pairs_peak, n_pairs);
+  stats->visibility_bytes =
+      ctx->visibility_capacity * sizeof(uint32_t) +
+      ctx->pair_capacity * (2 * sizeof(uint64_t) + sizeof(uint32_t));
+  stats->visibility_bytes_peak =
+      MAX(stats->visibility_bytes_peak, stats->visibility_bytes);
+}
+
+static void
+rasterizer_flush_sh_batch(raster_ctx *ctx, const instance_state *instance,
+                          sh_batch *batch) {
+  const gsmodel *model = instance->model;
+  vec3f *colors = ctx->colors + instance->offset;
+  if (batch->size == 0) return;
+
+  /* quantized models decode their base colors into ctx->colors first */
+  if (model->quantized) {
+    sh_evaluate_f16(model->sh_degree, model->quantized->sh, batch->idx,
+                    batch->dirs, batch->size, colors, colors);
+  } else {
+    sh_evaluate(model->sh_degree, model->sh, batch->idx, batch->dirs,
+                batch->size, model->colors, colors);
+  }
+  batch->size = 0;
+}
+
+/*
+ * Places the instances in the per-splat buffers and moves the camera into the
+ * space of each model.
+ */
+static void
+rasterizer_setup_instances(raster_ctx *ctx, camera *camera, mat4 view) {
+  const gsscene *scene = ctx->scene;
+  size_t offset = 0;
+
+  for (size_t s = 0; s < scene->n_instances; ++s) {
+    instance_state *instance = &ctx->instances[s];
+    mat4 M = scene->instances[s].transform;
+    mat4 MV = matmul4(M, view);
+
+    instance->model = scene->models[scene->instances[s].model];
+    instance->lod = rasterizer_model_lod(ctx, instance->model);
+    instance->offset = offset;
+    instance->n_splats = rasterizer_model_splats(ctx, instance->model);
+    instance->model_view = MV;
+    instance->W = (mat3){MV.vv[0][0], MV.vv[1][0], MV.vv[2][0],
+                         MV.vv[0][1], MV.vv[1][1], MV.vv[2][1],
+                         MV.vv[0][2], MV.vv[1][2], MV.vv[2][2]};
+
+    mat3 inv = inverse3((mat3){M.vv[0][0], M.vv[0][1], M.vv[0][2],
+                               M.vv[1][0], M.vv[1][1], M.vv[1][2],
+                               M.vv[2][0], M.vv[2][1], M.vv[2][2]});
+    vec3f p = {camera->pos.x - M.vv[3][0], camera->pos.y - M.vv[3][1],
+               camera->pos.z - M.vv[3][2]};
+    for (int c = 0; c < 3; ++c) {
+      instance->camera_pos.v[c] = p.x * inv.vv[0][c] + p.y * inv.vv[1][c] +
+                                  p.z * inv.vv[2][c];
+    }
+
+    offset += instance->n_splats;
+  }
+}
+
 static size_t
 rasterizer_get_n_tiles(raster_ctx *ctx) {
   return ctx->n_tiles.x * ctx->n_tiles.y;
 }
 
-void
-rasterizer_preprocess(raster_ctx *ctx, camera *camera, frame *frame) {
-  memset(ctx->visibility_tile_counts, 0,
-         ctx->n_tiles.x * ctx->n_tiles.y * sizeof(uint32_t));
-  memset(ctx->tile_ranges, 0, ctx->model->n_points * sizeof(tile_range));
+/*
+ * Projects the splats [lo, hi) of instance s and culls them against the view
+ * frustum. The survivors are appended to the n_valid splats of the chunk that
+ * starts at begin, see preprocess_project. Returns the new n_valid.
+ */
+static size_t
+preprocess_project_range(preprocess_args *args, size_t begin, uint32_t s,
+                         size_t lo, size_t hi, size_t n_valid) {
+  raster_ctx *ctx = args->ctx;
+  const instance_state *instance = &ctx->instances[s];
+  const gsmodel *model = instance->model;
+  transformed_point *out = ctx->sort_buffer + begin;
+  uint32_t *keys = ctx->sort_keys + 2 * ctx->capacity + begin;
+  uint32_t *slots = ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL
+                        ? ctx->splat_slots
+                        : NULL;
+
+  for (size_t i = lo; i < hi; i += PROJECT_BATCH_SIZE) {
+    size_t n = MIN(hi - i, PROJECT_BATCH_SIZE);
+    project_points batch;
+    for (size_t l = 0; l < PROJECT_BATCH_SIZE; ++l) {
+      /* the lanes past n repeat the last splat */
+      vec3f position =
+          model_position(model, i + MIN(l, n - 1) - instance->offset);
+      for (int c = 0; c < 3; ++c) batch.position[c][l] = position.v[c];
+    }
+    ctx->kernels.points(&batch, &instance->model_view, &args->params);
+
+    for (size_t l = 0; l < n; ++l) {
+      if (slots) slots[i + l] = RASTERIZER_NO_SLOT;
+      if (!batch.visible[l]) continue;
+
+      vec4f vview = {batch.view[0][l], batch.view[1][l], batch.view[2][l],
+                     batch.view[3][l]};
+      out[n_valid].view = vview;
+      out[n_valid].frame = (vec2f){batch.screen[0][l], batch.screen[1][l]};
+      out[n_valid].idx = i + l;
+      out[n_valid].instance = s;
+      keys[n_valid] = sort_float_key(vview.z);
+      if (slots) slots[i + l] = begin + n_valid;
+      n_valid += 1;
+    }
+  }
+  return n_valid;
+}
 
-  mat4 proj = camera_get_projection(camera);
-  mat4 view = camera_get_view(camera);
+/*
+ * Walks the bounding volume hierarchy of instance s and projects the splats
+ * [lo, hi) of the leaves that intersect the view frustum. Like
+ * preprocess_project_range otherwise.
+ */
+static size_t
+preprocess_project_bvh(preprocess_args *args, size_t begin, uint32_t s,
+                       size_t lo, size_t hi, size_t n_valid) {
+  raster_ctx *ctx = args->ctx;
+  const instance_state *instance = &ctx->instances[s];
+  const gsbvh *bvh = instance->model->bvh;
+  uint32_t stack[BVH_MAX_DEPTH];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    const bvh_node *node = &bvh->nodes[stack[--top]];
+    size_t node_lo = MAX(lo, instance->offset + node->begin);
+    size_t node_hi = MIN(hi, instance->offset + node->begin + node->count);
+    if (node_lo >= node_hi) continue;
+
+    if (!bvh_node_visible(node, &instance->model_view, &args->frustum)) {
+      if (ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL) {
+        for (size_t i = node_lo; i < node_hi; ++i) {
+          ctx->splat_slots[i] = RASTERIZER_NO_SLOT;
+        }
+      }
+    } else if (node->left == 0) {
+      n_valid =
+          preprocess_project_range(args, begin, s, node_lo, node_hi, n_valid);
+    } else {
+      /* left child first, which keeps the splats in index order */
+      stack[top++] = node->left + 1;
+      stack[top++] = node->left;
+    }
+  }
+  return n_valid;
+}
 
-  float tan_fovy = tanf(camera->fovy * 0.5f);
-  float tan_fovx =
-      tanf(camera->fovy * 0.5f) *
-      camera->aspect;  // float focal_y = frame->height / (2.0f * tan_fovy);
-  float focal_y = (frame->height * 0.5f) / tan_fovy;
-  float focal_x = (frame->width * 0.5f) / tan_fovx;
+/*
+ * Projects the splats [lo, hi) of instance s that the cut through its level of
+ * detail hierarchy draws, the points below refined nodes of level 1 and the
+ * drawn nodes. Like preprocess_project_range otherwise.
+ */
+static size_t
+preprocess_project_lod(preprocess_args *args, size_t begin, uint32_t s,
+                       size_t lo, size_t hi, size_t n_valid) {
+  raster_ctx *ctx = args->ctx;
+  const instance_state *instance = &ctx->instances[s];
+  size_t n = instance->model->n_points;
+  const uint8_t *states = ctx->lod_states + instance->offset + n;
+  size_t run = lo; /* first of the drawn splats before i */
+
+  for (size_t i = lo; i < hi; ++i) {
+    size_t local = i - instance->offset;
+    int drawn = local < n ? states[local / LOD_FANOUT] == LOD_REFINED
+                          : states[local - n] == LOD_DRAWN;
+    if (drawn) continue;
+
+    n_valid = preprocess_project_range(args, begin, s, run, i, n_valid);
+    if (ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL) {
+      ctx->splat_slots[i] = RASTERIZER_NO_SLOT;
+    }
+    run = i + 1;
+  }
+  return preprocess_project_range(args, begin, s, run, hi, n_valid);
+}
 
-  size_t n_valid_points = 0;
-  for (int i = 0; i < ctx->model->n_points; ++i) {
-    vec4f vertex =
-        (vec4f){ctx->model->positions[i].x, ctx->model->positions[i].y,
-                ctx->model->positions[i].z, 1.f};
-    vec4f vview = matmulv4(view, vertex);
-    if (vview.z < 0.f) continue;
-    vec4f vproj = matmulv4(proj, vview);
-
-    float rw = 1.f / (vproj.w + 1e-5f);
-    ctx->ndc_points[i].v[0] = (vproj.x * rw);
-    ctx->ndc_points[i].v[1] = (vproj.y * rw);
-    ctx->ndc_points[i].v[2] = (vproj.z * rw);
-
-    if (ctx->ndc_points[i].x < -1.f || ctx->ndc_points[i].x > 1.f ||
-        ctx->ndc_points[i].y < -1.f || ctx->ndc_points[i].y > 1.f ||
-        ctx->ndc_points[i].z < -1.f || ctx->ndc_points[i].z > 1.f) {
-      continue;
+/*
+ * Projects the splats in [begin, end) of the per-splat buffers and culls them
+ * against the view frustum, whole subtrees at a time for models with a
+ * bounding volume hierarchy or a level of detail cut. The survivors are
+ * compacted to the front of the range in ctx->sort_buffer, their depth keys
+ * into the same range of the scratch keys of the sort. The incremental sort
+ * also records the slot of every splat.
+ */
+static void
+preprocess_project(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  size_t n_valid = 0;
+
+  for (uint32_t s = 0; s < ctx->n_instances; ++s) {
+    const instance_state *instance = &ctx->instances[s];
+    const gsmodel *model = instance->model;
+    size_t lo = MAX(begin, instance->offset);
+    size_t hi = MIN(end, instance->offset + instance->n_splats);
+    if (lo >= hi) continue;
+
+    /* models that are still loading have outgrown their hierarchy */
+    if (instance->lod) {
+      n_valid = preprocess_project_lod(args, begin, s, lo, hi, n_valid);
+    } else if (model->bvh && model->bvh->n_points == (size_t)model->n_points) {
+      n_valid = preprocess_project_bvh(args, begin, s, lo, hi, n_valid);
+    } else {
+      n_valid = preprocess_project_range(args, begin, s, lo, hi, n_valid);
     }
+  }
+  ctx->chunk_offsets[chunk + 1] = n_valid;
+}
+
+/* decides the states of the nodes [begin, end) of one level of a hierarchy */
+static void
+preprocess_lod_states(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  const instance_state *instance = args->lod_instance;
+  const gslod *lod = instance->lod;
+  int level = args->lod_level;
+  size_t n = instance->model->n_points;
+  uint8_t *states = ctx->lod_states + instance->offset + n;
+  size_t first = lod->level_offsets[level - 1];
+  (void)chunk;
+
+  for (size_t j = begin; j < end; ++j) {
+    lod_state parent =
+        level == lod->n_levels
+            ? LOD_REFINED
+            : states[lod->level_offsets[level] + j / LOD_FANOUT];
+    states[first + j] = lod_node_state(
+        lod, first + j, parent, &instance->model_view, &args->frustum,
+        args->params.focal_y, ctx->lod_threshold);
+  }
+}
 
-    ctx->trans_points[n_valid_points].view = vview;
-    ctx->trans_points[n_valid_points].frame =
-        frame_ndc_to_screen(ctx->ndc_points[i], frame);
-    ctx->trans_points[n_valid_points].idx = i;
+/* exclusive prefix sum of the chunk totals, returns the overall total */
+static size_t
+rasterizer_scan_chunks(raster_ctx *ctx) {
+  ctx->chunk_offsets[0] = 0;
+  for (size_t c = 0; c < RASTERIZER_NUM_CHUNKS; ++c) {
+    ctx->chunk_offsets[c + 1] += ctx->chunk_offsets[c];
+  }
+  return ctx->chunk_offsets[RASTERIZER_NUM_CHUNKS];
+}
 
-    n_valid_points += 1;
+/* packs the keys of the visible splats of each chunk back to back */
+static void
+preprocess_compact(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  (void)end;
+  size_t offset = ctx->chunk_offsets[chunk];
+  size_t n_valid = ctx->chunk_offsets[chunk + 1] - offset;
+  const uint32_t *chunk_keys = ctx->sort_keys + 2 * ctx->capacity + begin;
+  uint32_t *keys = ctx->sort_keys + offset;
+  uint32_t *values = ctx->sort_keys + ctx->capacity + offset;
+
+  for (size_t j = 0; j < n_valid; ++j) {
+    keys[j] = chunk_keys[j];
+    values[j] = begin + j;
   }
+}
 
-  /* sort valid points */
-  qsort(ctx->trans_points, n_valid_points, sizeof(transformed_point),
-        comp_points);
+/*
+ * Picks the slots of the splats of the last order in [begin, end) that stay
+ * visible and clears them in splat_slots, which leaves the newly visible ones.
+ * The slots are kept in the same range of the values scratch of the sort.
+ */
+static void
+preprocess_find_kept(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  uint32_t *kept = ctx->sort_keys + 3 * ctx->capacity + begin;
+  uint32_t *slots = ctx->splat_slots;
+  size_t n_kept = 0;
+
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t idx = ctx->sorted_points[i];
+    if (idx >= args->n_points || slots[idx] == RASTERIZER_NO_SLOT) continue;
+    kept[n_kept++] = slots[idx];
+    slots[idx] = RASTERIZER_NO_SLOT;
+  }
+  ctx->chunk_offsets[chunk + 1] = n_kept;
+}
+
+/* packs the keys of the splats preprocess_find_kept picked back to back */
+static void
+preprocess_split_kept(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  size_t offset = ctx->chunk_offsets[chunk];
+  size_t n_kept = ctx->chunk_offsets[chunk + 1] - offset;
+  const uint32_t *proj_keys = ctx->sort_keys + 2 * ctx->capacity;
+  const uint32_t *kept = ctx->sort_keys + 3 * ctx->capacity + begin;
+  uint32_t *keys = ctx->sort_keys + offset;
+  uint32_t *values = keys + ctx->capacity;
+  (void)end;
+
+  for (size_t j = 0; j < n_kept; ++j) {
+    keys[j] = proj_keys[kept[j]];
+    values[j] = kept[j];
+  }
+}
+
+/* counts the newly visible splats in [begin, end) */
+static void
+preprocess_count_new(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  size_t n_new = 0;
+
+  for (size_t i = begin; i < end; ++i) {
+    n_new += ctx->splat_slots[i] != RASTERIZER_NO_SLOT;
+  }
+  ctx->chunk_offsets[chunk + 1] = n_new;
+}
+
+/* packs the keys of the newly visible splats after the kept ones */
+static void
+preprocess_split_new(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  const uint32_t *proj_keys = ctx->sort_keys + 2 * ctx->capacity;
+  uint32_t *keys = ctx->sort_keys + args->n_kept + ctx->chunk_offsets[chunk];
+  uint32_t *values = keys + ctx->capacity;
+  size_t n = 0;
+
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t slot = ctx->splat_slots[i];
+    if (slot == RASTERIZER_NO_SLOT) continue;
+    keys[n] = proj_keys[slot];
+    values[n++] = slot;
+  }
+}
+
+/* insertion sorts the kept keys [begin, end), flags the chunk if it gives up */
+static void
+preprocess_sort_kept(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  uint32_t *keys = ctx->sort_keys;
+
+  ctx->chunk_offsets[chunk + 1] =
+      !sort_insertion_u32(keys + begin, keys + ctx->capacity + begin,
+                          end - begin, RASTERIZER_MAX_SORT_SHIFTS);
+}
+
+/*
+ * Sorts the visible splats starting from the depth order of the last frame.
+ * The splats that stay visible keep their old order and are re-sorted with
+ * insertion sorts, one per chunk on the thread pool and then one over all of
+ * them that only moves keys across the chunk bounds. This is linear while the
+ * camera moves smoothly. Newly visible splats are radix sorted and merged in.
+ * After a camera jump the chunks give up early and all keys are radix sorted
+ * before the pass over all of them. The next frames then sort by depth right
+ * away, for longer each time the camera keeps jumping.
+ */
+static const uint32_t *
+rasterizer_sort_incremental(raster_ctx *ctx, preprocess_args *args,
+                            size_t n_points, size_t n_valid_points) {
+  size_t cap = ctx->capacity;
+  uint32_t *keys = ctx->sort_keys;
+  uint32_t *values = keys + cap;
+  uint32_t *tmp_keys = keys + 2 * cap;
+  uint32_t *tmp_values = keys + 3 * cap;
+
+  /* splats that stay visible, in the order of the last frame */
+  args->n_points = n_points;
+  tpool_parallel_for(ctx->tpool, ctx->n_sorted, RASTERIZER_NUM_CHUNKS,
+                     preprocess_find_kept, args);
+  args->n_kept = rasterizer_scan_chunks(ctx);
+  tpool_parallel_for(ctx->tpool, ctx->n_sorted, RASTERIZER_NUM_CHUNKS,
+                     preprocess_split_kept, args);
+
+  /* followed by the newly visible ones, the keys are still in tmp_keys */
+  tpool_parallel_for(ctx->tpool, n_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_count_new, args);
+  rasterizer_scan_chunks(ctx);
+  tpool_parallel_for(ctx->tpool, n_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_split_new, args);
+
+  size_t n_kept = args->n_kept;
+  size_t n_new = n_valid_points - n_kept;
+  int sorted = n_new * RASTERIZER_MAX_NEW_SPLATS <= n_valid_points;
+  if (sorted) {
+    tpool_parallel_for(ctx->tpool, n_kept, RASTERIZER_NUM_CHUNKS,
+                       preprocess_sort_kept, args);
+    sorted = rasterizer_scan_chunks(ctx) == 0 &&
+             sort_insertion_u32(keys, values, n_kept,
+                                RASTERIZER_MAX_SORT_SHIFTS);
+  }
+  if (!sorted) {
+    ctx->sort_backoff = MIN(MAX(2 * ctx->sort_backoff, 1),
+                            RASTERIZER_MAX_SORT_BACKOFF);
+    ctx->sort_skip = ctx->sort_backoff;
+    sort_radix_u32(ctx->tpool, keys, values, tmp_keys, tmp_values,
+                   n_valid_points);
+    return values;
+  }
+  ctx->sort_backoff = 0;
+  if (n_new == 0) return values;
+
+  sort_radix_u32(ctx->tpool, keys + n_kept, values + n_kept, tmp_keys,
+                 tmp_values, n_new);
+  sort_merge_u32(keys, values, n_kept, n_valid_points, tmp_keys, tmp_values);
+  return tmp_values;
+}
+
+/*
+ * Sorts the keys of the visible splats and returns their slots in
+ * ctx->sort_buffer in depth order. The tile sort keeps the projection order.
+ */
+static const uint32_t *
+rasterizer_sort_depth(raster_ctx *ctx, preprocess_args *args, size_t n_points,
+                      size_t n_valid_points) {
+  uint32_t *keys = ctx->sort_keys;
+  size_t cap = ctx->capacity;
+
+  /* without a last order, or while the camera keeps jumping, sort by depth */
+  if (ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL && ctx->n_sorted > 0) {
+    if (ctx->sort_skip == 0) {
+      return rasterizer_sort_incremental(ctx, args, n_points, n_valid_points);
+    }
+    ctx->sort_skip -= 1;
+  }
+
+  tpool_parallel_for(ctx->tpool, n_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_compact, args);
+  if (ctx->sort_mode != RASTERIZER_SORT_TILE) {
+    sort_radix_u32(ctx->tpool, keys, keys + cap, keys + 2 * cap,
+                   keys + 3 * cap, n_valid_points);
+  }
+  return keys + cap;
+}
+
+/* gathers the visible splats in sorted order and remembers the order */
+static void
+preprocess_gather(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  (void)chunk;
+
+  for (size_t i = begin; i < end; ++i) {
+    ctx->trans_points[i] = ctx->sort_buffer[args->order[i]];
+  }
+  if (ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL) {
+    for (size_t i = begin; i < end; ++i) {
+      ctx->sorted_points[i] = ctx->trans_points[i].idx;
+    }
+  }
+}
+
+/* gathers the visible splats [begin, begin + n) into the lanes of batch */
+static void
+rasterizer_load_splats(raster_ctx *ctx, size_t begin, size_t n,
+                       project_splats *batch) {
+  for (size_t l = 0; l < PROJECT_BATCH_SIZE; ++l) {
+    /* the lanes past n repeat the last splat */
+    const transformed_point *point = &ctx->trans_points[begin + MIN(l, n - 1)];
+    const instance_state *instance = &ctx->instances[point->instance];
+    size_t local = point->idx - instance->offset;
+    vec3f scale = model_scale(instance->model, local);
+    vec4f rotation = model_rotation(instance->model, local);
+
+    for (int c = 0; c < 3; ++c) {
+      batch->view[c][l] = point->view.v[c];
+      batch->scale[c][l] = scale.v[c];
+    }
+    for (int c = 0; c < 2; ++c) batch->screen[c][l] = point->frame.v[c];
+    for (int c = 0; c < 4; ++c) batch->rotation[c][l] = rotation.v[c];
+    for (int c = 0; c < 9; ++c) batch->W[c][l] = instance->W.v[c];
+    batch->opacity[l] = model_opacity(instance->model, local);
+  }
+}
+
+/* the ellipse of a splat in the tile range, see splat_ellipse */
+static inline splat_ellipse
+rasterizer_splat_ellipse(const raster_ctx *ctx, tile_range range, vec2f mean,
+                         vec3f con, float cutoff) {
+  splat_ellipse e = {.full = range.upper.x - range.lower.x < 2 ||
+                             range.upper.y - range.lower.y < 2};
+  if (e.full) return e;
+
+  float k2 = 2.f * cutoff;
+  e.mean_x = mean.x / ctx->tile_size.x;
+  e.mean_y = mean.y;
+  e.b = con.y;
+  e.k2a = k2 * con.x;
+  e.det = con.x * con.z - con.y * con.y;
+  e.scale = 1.f / (con.x * ctx->tile_size.x);
+  e.v_extent = sqrtf(e.k2a / e.det);
+  e.v_right = -con.y * sqrtf(k2 / (con.z * e.det));
+  return e;
+}
+
+/* the tiles [*begin, *end) of the row ty that the sorted splat i reaches */
+static inline void
+rasterizer_splat_row(const raster_ctx *ctx, size_t i, uint32_t ty,
+                     uint32_t *begin, uint32_t *end) {
+  const splat_ellipse *e = &ctx->ellipses[i];
+  tile_range range = ctx->tile_ranges[i];
+  if (e->full) {
+    *begin = range.lower.x;
+    *end = range.upper.x;
+    return;
+  }
+
+  /* the pixel centers of the row */
+  float v0 = (float)(ty * ctx->tile_size.y) - e->mean_y;
+  float v1 = v0 + (float)(ctx->tile_size.y - 1);
+  float v_max = fminf(v1, fmaxf(v0, e->v_right));
+  float v_min = fminf(v1, fmaxf(v0, -e->v_right));
+  float w_max = sqrtf(fmaxf(e->k2a - e->det * v_max * v_max, 0.f));
+  float w_min = sqrtf(fmaxf(e->k2a - e->det * v_min * v_min, 0.f));
+
+  float lower = floorf(e->mean_x + (-e->b * v_min - w_min) * e->scale);
+  float upper = floorf(e->mean_x + (-e->b * v_max + w_max) * e->scale) + 1.f;
+  lower = fminf(fmaxf(lower, range.lower.x), range.upper.x);
+  upper = fmaxf(fminf(upper, range.upper.x), lower);
+  if (v1 < -e->v_extent || v0 > e->v_extent) upper = lower;
+  *begin = (uint32_t)lower;
+  *end = (uint32_t)upper;
+}
+
+/*
+ * Computes the screen space conic, extent and tile range of the visible splats
+ * in [begin, end) in batches and decodes and evaluates their colors. Depth
+ * sorted splats are counted into the tile histogram of the chunk, for the tile
+ * sort the chunk counts its tile-splat pairs.
+ */
+static void
+preprocess_setup(void *arg, size_t chunk, size_t begin, size_t end) {
+  preprocess_args *args = (preprocess_args *)arg;
+  raster_ctx *ctx = args->ctx;
+  size_t n_tiles = rasterizer_get_n_tiles(ctx);
+  uint32_t *tile_counts = ctx->chunk_tile_counts + chunk * n_tiles;
+  sh_batch *batches = ctx->sh_batches + chunk * ctx->n_instances;
+  size_t n_pairs = 0;
+
+  if (ctx->sort_mode != RASTERIZER_SORT_TILE) {
+    memset(tile_counts, 0, n_tiles * sizeof(uint32_t));
+  }
+
+  project_splats batch;
+  for (size_t i = begin; i < end; ++i) {
+    size_t l = (i - begin) % PROJECT_BATCH_SIZE;
+    if (l == 0) {
+      rasterizer_load_splats(ctx, i, MIN(end - i, PROJECT_BATCH_SIZE), &batch);
+      ctx->kernels.splats(&batch, &args->params);
+    }
+    ctx->tile_ranges[i] = (tile_range){0};
 
-  for (int i = 0; i < n_valid_points; ++i) {
     size_t idx = ctx->trans_points[i].idx;
-    vec4f vview = ctx->trans_points[i].view;
-    vec3f cov = compute_cov2d(&vview, &view, &ctx->model->cov3d[idx], focal_x,
-                              focal_y, tan_fovx, tan_fovy);
-
-    const float h_var = 0.3f;
-    const float det_cov = cov.x * cov.z - cov.y * cov.y;
-    cov.x += h_var;
-    cov.z += h_var;
-    const float det_cov_plus_h_cov = cov.x * cov.z - cov.y * cov.y;
-    const float det = det_cov_plus_h_cov;
-
-    if (det == 0.0f) continue;
-
-    float det_inv = 1.f / det;
-    vec3f inv_cov2d = {cov.z * det_inv, -cov.y * det_inv, cov.x * det_inv};
-
-    float mid = 0.5f * (cov.x + cov.z);
-    float lambda1 = mid + sqrtf(fmaxf(0.1f, mid * mid - det));
-    float lambda2 = mid - sqrtf(fmaxf(0.1f, mid * mid - det));
-    float radius = ceilf(3.f * sqrtf(fmaxf(lambda1, lambda2)));
-    if (radius < 1.f) continue;
+    uint32_t s = ctx->trans_points[i].instance;
+    const instance_state *instance = &ctx->instances[s];
+    size_t local = idx - instance->offset;
+    /* nodes of a hierarchy have no view-dependent color */
+    const gsmodel *model = model_source(instance->model, &local);
+
+    float cutoff = batch.cutoff[l];
+    if (cutoff == 0.f) continue;
+    vec3f inv_cov2d = {batch.conic[0][l], batch.conic[1][l],
+                       batch.conic[2][l]};
     vec2f point_screen = ctx->trans_points[i].frame;
     vec2u rect_min, rect_max;
-    rect_min.x = fmaxf(floor(point_screen.x - radius), 0);
-    rect_min.y = fmaxf(floor(point_screen.y - radius), 0);
-    rect_max.x = fminf(point_screen.x + radius, frame->width);
-    rect_max.y = fminf(point_screen.y + radius, frame->height);
+    rect_min.x = batch.rect[0][l];
+    rect_min.y = batch.rect[1][l];
+    rect_max.x = batch.rect[2][l];
+    rect_max.y = batch.rect[3][l];
     if ((rect_max.x - rect_min.x) * (rect_max.y - rect_min.y) == 0) continue;
 
     ctx->tile_ranges[i] = (tile_range){
@@ -292,54 +1044,279 @@ rasterizer_preprocess(raster_ctx *ctx, camera *camera, frame *frame) {
             },
     };
 
-    for (uint32_t ty = ctx->tile_ranges[i].lower.y;
-         ty < ctx->tile_ranges[i].upper.y; ++ty) {
-      for (uint32_t tx = ctx->tile_ranges[i].lower.x;
-           tx < ctx->tile_ranges[i].upper.x; ++tx) {
-        size_t tile = ty * ctx->n_tiles.x + tx;
-        ctx->visibility_tile_counts[tile] += 1;
+    blend_splat *record = &ctx->records[idx];
+    record->mean = point_screen;
+    record->conic = inv_cov2d;
+    record->opacity = batch.opacity[l];
+    record->extent = (vec2f){batch.extent[0][l], batch.extent[1][l]};
+
+    tile_range range = ctx->tile_ranges[i];
+    ctx->ellipses[i] =
+        rasterizer_splat_ellipse(ctx, range, point_screen, inv_cov2d, cutoff);
+    for (uint32_t ty = range.lower.y; ty < range.upper.y; ++ty) {
+      uint32_t tx_begin, tx_end;
+      rasterizer_splat_row(ctx, i, ty, &tx_begin, &tx_end);
+      if (ctx->sort_mode == RASTERIZER_SORT_TILE) {
+        n_pairs += tx_end - tx_begin;
+        continue;
+      }
+      for (uint32_t tx = tx_begin; tx < tx_end; ++tx) {
+        tile_counts[ty * ctx->n_tiles.x + tx] += 1;
       }
     }
 
-    ctx->inv_cov2d[idx] = inv_cov2d;
-    ctx->radii[idx] = radius;
-    ctx->ndc_points[idx].x = point_screen.x;
-    ctx->ndc_points[idx].y = point_screen.y;
+    if (model->quantized) {
+      ctx->colors[idx] = quantize_decode_color(model->quantized, local);
+    } else if (ctx->owns_colors && model->sh_degree == 0) {
+      ctx->colors[idx] = model->colors[local];
+    }
+
+    if (model->sh_degree > 0) {
+      sh_batch *batch = &batches[s];
+      batch->idx[batch->size] = local;
+      batch->dirs[batch->size] =
+          sub3(model_position(model, local), instance->camera_pos);
+      if (++batch->size == SH_BATCH_SIZE) {
+        rasterizer_flush_sh_batch(ctx, instance, batch);
+      }
+    }
   }
 
-  /* tile offset prefix sum for visibility */
-  ctx->visibility_tile_offsets[0] = 0;
-  for (size_t i = 1; i < ctx->n_tiles.x * ctx->n_tiles.y + 1; ++i) {
-    ctx->visibility_tile_offsets[i] = ctx->visibility_tile_offsets[i - 1] +
-                                      ctx->visibility_tile_counts[i - 1];
+  for (size_t s = 0; s < ctx->n_instances; ++s) {
+    rasterizer_flush_sh_batch(ctx, &ctx->instances[s], &batches[s]);
+  }
+
+  /* the colors are final once the SH batches are flushed */
+  for (size_t i = begin; i < end; ++i) {
+    if (ctx->tile_ranges[i].lower.y == ctx->tile_ranges[i].upper.y) continue;
+    size_t idx = ctx->trans_points[i].idx;
+    ctx->records[idx].color = ctx->colors[idx];
+  }
+  if (ctx->sort_mode == RASTERIZER_SORT_TILE) {
+    ctx->chunk_offsets[chunk + 1] = n_pairs;
   }
-  size_t total_vis =
-      ctx->visibility_tile_offsets[ctx->n_tiles.x * ctx->n_tiles.y];
+}
+
+/*
+ * Turns the tile histograms of the chunks into offsets of each chunk within
+ * the tiles [begin, end) and sums the tile totals of the range.
+ */
+static void
+preprocess_merge_tile_counts(void *arg, size_t chunk, size_t begin,
+                             size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  size_t n_tiles = rasterizer_get_n_tiles(ctx);
+  size_t range_sum = 0;
+
+  for (size_t tile = begin; tile < end; ++tile) {
+    uint32_t sum = 0;
+    for (size_t c = 0; c < RASTERIZER_NUM_CHUNKS; ++c) {
+      uint32_t count = ctx->chunk_tile_counts[c * n_tiles + tile];
+      ctx->chunk_tile_counts[c * n_tiles + tile] = sum;
+      sum += count;
+    }
+    ctx->visibility_tile_counts[tile] = sum;
+    range_sum += sum;
+  }
+  ctx->chunk_offsets[chunk + 1] = range_sum;
+}
 
-  assert(total_vis <= ctx->model->n_points * AVG_TILES_TOUCHED_HEURISTIC);
-  memset(ctx->visibility_tile_counts, 0,
-         ctx->n_tiles.x * ctx->n_tiles.y * sizeof(uint32_t));
+/* exclusive prefix sum of the tile counts in [begin, end) */
+static void
+preprocess_tile_offsets(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  uint32_t offset = ctx->chunk_offsets[chunk];
 
-  /* update visibility indices */
-  for (size_t i = 0; i < n_valid_points; ++i) {
+  for (size_t tile = begin; tile < end; ++tile) {
+    ctx->visibility_tile_offsets[tile] = offset;
+    offset += ctx->visibility_tile_counts[tile];
+  }
+}
+
+/*
+ * Writes the sorted splats in [begin, end) into the tile lists. The chunks
+ * partition the sorted splats like in preprocess_setup, so each one owns a
+ * contiguous slot of every tile and depth order is kept.
+ */
+static void
+preprocess_scatter(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  uint32_t *cursors =
+      ctx->chunk_tile_counts + chunk * rasterizer_get_n_tiles(ctx);
+
+  for (size_t i = begin; i < end; ++i) {
+    size_t idx = ctx->trans_points[i].idx;
     for (uint32_t ty = ctx->tile_ranges[i].lower.y;
          ty < ctx->tile_ranges[i].upper.y; ++ty) {
-      for (uint32_t tx = ctx->tile_ranges[i].lower.x;
-           tx < ctx->tile_ranges[i].upper.x; ++tx) {
+      uint32_t tx_begin, tx_end;
+      rasterizer_splat_row(ctx, i, ty, &tx_begin, &tx_end);
+      for (uint32_t tx = tx_begin; tx < tx_end; ++tx) {
         size_t tile = ty * ctx->n_tiles.x + tx;
-        size_t idx = ctx->trans_points[i].idx;
         ctx->visibility_tile_points[ctx->visibility_tile_offsets[tile] +
-                                    ctx->visibility_tile_counts[tile]++] = idx;
+                                    cursors[tile]++] = idx;
+      }
+    }
+  }
+}
+
+/* writes a tile << 32 | depth key per tile touched by the splats in range */
+static void
+preprocess_emit_pairs(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  size_t pair = ctx->chunk_offsets[chunk];
+
+  for (size_t i = begin; i < end; ++i) {
+    tile_range range = ctx->tile_ranges[i];
+    uint64_t depth = sort_float_key(ctx->trans_points[i].view.z);
+    uint32_t idx = ctx->trans_points[i].idx;
+    for (uint32_t ty = range.lower.y; ty < range.upper.y; ++ty) {
+      uint32_t tx_begin, tx_end;
+      rasterizer_splat_row(ctx, i, ty, &tx_begin, &tx_end);
+      for (uint32_t tx = tx_begin; tx < tx_end; ++tx) {
+        uint64_t tile = ty * ctx->n_tiles.x + tx;
+        ctx->pair_keys[pair] = tile << 32 | depth;
+        ctx->visibility_tile_points[pair] = idx;
+        pair += 1;
       }
     }
   }
 }
 
+/*
+ * Reads the tile offsets off the sorted pairs in [begin, end). Each offset is
+ * written by the pair that starts the tile, or the first pair after it for
+ * empty tiles.
+ */
+static void
+preprocess_identify_tiles(void *arg, size_t chunk, size_t begin, size_t end) {
+  raster_ctx *ctx = ((preprocess_args *)arg)->ctx;
+  (void)chunk;
+
+  for (size_t i = begin; i < end; ++i) {
+    size_t tile = ctx->pair_keys[i] >> 32;
+    size_t first = i > 0 ? (ctx->pair_keys[i - 1] >> 32) + 1 : 0;
+    for (size_t t = first; t <= tile; ++t) {
+      ctx->visibility_tile_offsets[t] = i;
+    }
+  }
+}
+
+/*
+ * Bins the visible splats by sorting one tile << 32 | depth key per touched
+ * tile, as in the reference 3DGS rasterizer. Unlike the depth sort followed by
+ * the scatter into tiles, splats do not have to be sorted beforehand and all
+ * steps run in parallel.
+ */
+static void
+rasterizer_sort_tiles(raster_ctx *ctx, preprocess_args *args,
+                      size_t n_valid_points) {
+  size_t n_tiles = rasterizer_get_n_tiles(ctx);
+  size_t n_pairs = rasterizer_scan_chunks(ctx);
+  rasterizer_reserve_visibility(ctx, n_pairs);
+
+  tpool_parallel_for(ctx->tpool, n_valid_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_emit_pairs, args);
+
+  int key_bits = 32;
+  while (((size_t)1 << (key_bits - 32)) < n_tiles) key_bits += 1;
+  sort_radix_u64(ctx->tpool, ctx->pair_keys, ctx->visibility_tile_points,
+                 ctx->pair_keys + ctx->pair_capacity, ctx->pair_values,
+                 n_pairs, key_bits);
+
+  tpool_parallel_for(ctx->tpool, n_pairs, RASTERIZER_NUM_CHUNKS,
+                     preprocess_identify_tiles, args);
+  size_t last = n_pairs > 0 ? (ctx->pair_keys[n_pairs - 1] >> 32) + 1 : 0;
+  for (size_t t = last; t <= n_tiles; ++t) {
+    ctx->visibility_tile_offsets[t] = n_pairs;
+  }
+}
+
+void
+rasterizer_preprocess(raster_ctx *ctx, camera *camera, frame *frame) {
+  rasterizer_reserve(ctx);
+
+  mat4 proj = camera_get_projection(camera);
+  mat4 view = camera_get_view(camera);
+
+  float tan_fovy = tanf(camera->fovy * 0.5f);
+  float tan_fovx =
+      tanf(camera->fovy * 0.5f) *
+      camera->aspect;  // float focal_y = frame->height / (2.0f * tan_fovy);
+  float focal_y = (frame->height * 0.5f) / tan_fovy;
+  float focal_x = (frame->width * 0.5f) / tan_fovx;
+
+  preprocess_args args = {
+      .ctx = ctx,
+      .params =
+          {
+              .proj = proj,
+              .focal_x = focal_x,
+              .focal_y = focal_y,
+              .tan_fovx = tan_fovx,
+              .tan_fovy = tan_fovy,
+              .width = frame->width,
+              .height = frame->height,
+              .min_alpha = RASTERIZER_MIN_ALPHA,
+          },
+      .frustum = {tan_fovx, tan_fovy, camera->near, camera->far},
+  };
+
+  rasterizer_setup_instances(ctx, camera, view);
+
+  /* cut the level of detail hierarchies from the root down */
+  for (size_t s = 0; s < ctx->n_instances; ++s) {
+    args.lod_instance = &ctx->instances[s];
+    const gslod *lod = args.lod_instance->lod;
+    for (args.lod_level = lod ? lod->n_levels : 0; args.lod_level > 0;
+         --args.lod_level) {
+      size_t n_nodes = lod->level_offsets[args.lod_level] -
+                       lod->level_offsets[args.lod_level - 1];
+      tpool_parallel_for(ctx->tpool, n_nodes, RASTERIZER_NUM_CHUNKS,
+                         preprocess_lod_states, &args);
+    }
+  }
+
+  /* project and cull */
+  size_t n_points = rasterizer_num_splats(ctx);
+  tpool_parallel_for(ctx->tpool, n_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_project, &args);
+  size_t n_valid_points = rasterizer_scan_chunks(ctx);
+
+  /* sort (depth, slot) pairs, then move each splat once */
+  args.order = rasterizer_sort_depth(ctx, &args, n_points, n_valid_points);
+  tpool_parallel_for(ctx->tpool, n_valid_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_gather, &args);
+  ctx->n_sorted =
+      ctx->sort_mode == RASTERIZER_SORT_INCREMENTAL ? n_valid_points : 0;
+
+  /* conics, colors and per-chunk tile histograms */
+  tpool_parallel_for(ctx->tpool, n_valid_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_setup, &args);
+
+  if (ctx->sort_mode == RASTERIZER_SORT_TILE) {
+    rasterizer_sort_tiles(ctx, &args, n_valid_points);
+    return;
+  }
+
+  /* tile offset prefix sum for visibility */
+  size_t n_tiles = rasterizer_get_n_tiles(ctx);
+  tpool_parallel_for(ctx->tpool, n_tiles, RASTERIZER_NUM_CHUNKS,
+                     preprocess_merge_tile_counts, &args);
+  size_t total_vis = rasterizer_scan_chunks(ctx);
+  tpool_parallel_for(ctx->tpool, n_tiles, RASTERIZER_NUM_CHUNKS,
+                     preprocess_tile_offsets, &args);
+  ctx->visibility_tile_offsets[n_tiles] = total_vis;
+  rasterizer_reserve_visibility(ctx, total_vis);
+
+  /* update visibility indices */
+  tpool_parallel_for(ctx->tpool, n_valid_points, RASTERIZER_NUM_CHUNKS,
+                     preprocess_scatter, &args);
+}
+
 static void
 render_kernel(void *args) {
   render_batch_args *rargs = (render_batch_args *)args;
   raster_ctx *ctx = rargs->ctx;
-  camera *camera = rargs->camera;
   frame *frame = rargs->frame;
   size_t tile = rargs->tile;
 
@@ -357,83 +1334,56 @@ render_kernel(void *args) {
   uint32_t *visible = ctx->visibility_tile_points + visibility_begin;
   uint32_t itercnt = visibility_end - visibility_begin;
 
-  vec3f *throughputs =
-      ctx->throughputs + (tile * ctx->tile_size.x * ctx->tile_size.y);
-
-  for (size_t i = 0; i < ctx->tile_size.x * ctx->tile_size.y; ++i) {
-    throughputs[i].x = 1.f;
-    throughputs[i].y = 1.f;
-    throughputs[i].z = 1.f;
-  }
-
-  uint8_t *done = calloc(ctx->tile_size.x * ctx->tile_size.y, sizeof(uint8_t));
-  size_t n_done = 0;
-
-  for (size_t z = 0; z < itercnt; ++z) {
-    // if (n_done == ctx->tile_size.x * ctx->tile_size.y) break;
-    uint32_t i = visible[z];
-    vec3f color = ctx->model->colors[i];
-    float opacity = ctx->model->opacities[i];
-    vec3f con_o = ctx->inv_cov2d[i];
-    float radius = ctx->radii[i];
-    vec2f p = {ctx->ndc_points[i].x, ctx->ndc_points[i].y};
-    int px0 = MAX(x_start, (int)(p.x - radius));
-    int px1 = MIN(x_end, (int)(p.x + radius + 1));
-    int py0 = MAX(y_start, (int)(p.y - radius));
-    int py1 = MIN(y_end, (int)(p.y + radius + 1));
-
-    for (size_t y = py0; y < py1; ++y) {
-      vec3f *row_colors = (frame->pixels + y * frame->width);
-      for (size_t x = px0; x < px1; ++x) {
-        size_t tile_idx = (y - y_start) * ctx->tile_size.x + (x - x_start);
-        if (done[tile_idx]) continue;
-
-        vec2f pix = {(float)x, (float)y};
-        vec2f d = {p.x - pix.x, p.y - pix.y};
-        // if (fabsf(d.x) > radius || fabsf(d.y) > radius) continue;
-
-        float power = -0.5f * (con_o.x * d.x * d.x + con_o.z * d.y * d.y) -
-                      con_o.y * d.x * d.y;
-        if (power > 0.0f) continue;
-        float alpha = fminf(0.99f, opacity * fast_exp_neg(-power));
-        // float alpha = fminf(0.99f, opacity * exp2f(power * LOG2E));
-        // float alpha = fminf(0.99f, opacity * expf(power));
-        if (alpha < 0.004f) /* 1/255 ~= 0.004 */
-          continue;
-
-        vec3f co = {
-            row_colors[x].x + color.x * alpha * throughputs[tile_idx].x,
-            row_colors[x].y + color.y * alpha * throughputs[tile_idx].y,
-            row_colors[x].z + color.z * alpha * throughputs[tile_idx].z};
-
-        row_colors[x] = co;
-        throughputs[tile_idx].x *= (1.f - alpha);
-        throughputs[tile_idx].y *= (1.f - alpha);
-        throughputs[tile_idx].z *= (1.f - alpha);
-
-        if (fminf(throughputs[tile_idx].x,
-                  fminf(throughputs[tile_idx].y, throughputs[tile_idx].z)) <
-            0.001f) {
-          done[tile_idx] = 1;
-          n_done++;
-          break;
-        }
+  size_t n = ctx->tile_pixels;
+  blend_tile bt = {(int)x_start,
+                   (int)y_start,
+                   (int)(x_end - x_start),
+                   (int)(y_end - y_start),
+                   (int)ctx->tile_size.x,
+                   ctx->tile_cols,
+                   ctx->tile_rows,
+                   {rargs->pixels, rargs->pixels + n, rargs->pixels + 2 * n},
+                   rargs->pixels + 3 * n,
+                   RASTERIZER_MIN_ALPHA};
+
+  /* blend over the frame, lanes outside of it stay saturated */
+  for (size_t i = 0; i < n; ++i) {
+    bt.color[0][i] = bt.color[1][i] = bt.color[2][i] = 0.f;
+    bt.transmittance[i] = 0.f;
+  }
+  for (size_t y = y_start; y < y_end; ++y) {
+    const vec3f *row_colors = frame->pixels + y * frame->width;
+    for (size_t x = x_start; x < x_end; ++x) {
+      size_t i = (y - y_start) * ctx->tile_size.x + (x - x_start);
+      bt.color[0][i] = row_colors[x].x;
+      bt.color[1][i] = row_colors[x].y;
+      bt.color[2][i] = row_colors[x].z;
+      bt.transmittance[i] = 1.f;
+    }
+  }
 
-      }
+  ctx->blend.splats(&bt, ctx->records, visible, itercnt);
+
+  for (size_t y = y_start; y < y_end; ++y) {
+    vec3f *row_colors = frame->pixels + y * frame->width;
+    for (size_t x = x_start; x < x_end; ++x) {
+      size_t i = (y - y_start) * ctx->tile_size.x + (x - x_start);
+      row_colors[x] = (vec3f){{bt.color[0][i], bt.color[1][i], bt.color[2][i]}};
     }
   }
-  free(done);
 }
 
 static void
 render_batch(void *args) {
   render_batch_args *rargs = (render_batch_args *)args;
+  rargs->pixels = malloc(4 * rargs->ctx->tile_pixels * sizeof(float));
   for (size_t i = rargs->tile_start; i < rargs->tile_end; ++i) {
     if (i >= rargs->ctx->n_tiles.x * rargs->ctx->n_tiles.y) break;
 
     rargs->tile = i;
     render_kernel(rargs);
   }
+  free(rargs->pixels);
 }
 
 void
@@ -444,7 +1394,8 @@ rasterizer_render(raster_ctx *ctx, camera *camera, frame *frame) {
                                         frame,
                                         0,
                                         b * RASTERIZER_TILE_BATCH_SIZE,
-                                        (b + 1) * RASTERIZER_TILE_BATCH_SIZE};
+                                        (b + 1) * RASTERIZER_TILE_BATCH_SIZE,
+                                        NULL};
     tpool_add_work(ctx->tpool, render_batch, &ctx->rargs[b]);
   }
   tpool_wait(ctx->tpool);
@@ -462,16 +1413,28 @@ void
 rasterizer_context_destroy(raster_ctx *ctx) {
   if (ctx) {
     free(ctx->tile_ranges);
+    free(ctx->ellipses);
+    free(ctx->records);
     free(ctx->visibility_tile_offsets);
     free(ctx->visibility_tile_counts);
     free(ctx->visibility_tile_points);
-    free(ctx->ndc_points);
     free(ctx->trans_points);
-    free(ctx->radii);
-    free(ctx->inv_cov2d);
-    free(ctx->throughputs);
+    free(ctx->sort_buffer);
+    free(ctx->sort_keys);
+    free(ctx->splat_slots);
+    free(ctx->sorted_points);
+    free(ctx->pair_keys);
+    free(ctx->pair_values);
+    free(ctx->lod_states);
+    if (ctx->owns_colors) free(ctx->colors);
+    free(ctx->tile_cols);
+    free(ctx->tile_rows);
     free(ctx->rargs);
+    free(ctx->instances);
+    free(ctx->chunk_tile_counts);
+    free(ctx->sh_batches);
     tpool_destroy(ctx->tpool);
+    if (ctx->owns_scene) scene_destroy(ctx->scene);
   }
   free(ctx);
 }
@@ -0,0 +1,155 @@
+#include <splatc/json.h>
+#include <splatc/scene.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_MAX_PATH 4096
+
+gsscene *
+scene_create() {
+  return calloc(1, sizeof(gsscene));
+}
+
+size_t
+scene_add_model(gsscene *scene, gsmodel *model) {
+  scene->models =
+      realloc(scene->models, (scene->n_models + 1) * sizeof(gsmodel *));
+  scene->models[scene->n_models] = model;
+  return scene->n_models++;
+}
+
+void
+scene_add_instance(gsscene *scene, size_t model, mat4 transform) {
+  scene->instances = realloc(scene->instances,
+                             (scene->n_instances + 1) * sizeof(gsinstance));
+  scene->instances[scene->n_instances++] = (gsinstance){model, transform};
+}
+
+size_t
+scene_num_points(const gsscene *scene) {
+  size_t n = 0;
+  for (size_t i = 0; i < scene->n_instances; ++i) {
+    n += scene->models[scene->instances[i].model]->n_points;
+  }
+  return n;
+}
+
+/* builds the row vector transform of x -> R (s * x) + t */
+static mat4
+scene_compose_transform(vec3f translation, vec4f rotation, vec3f scale) {
+  mat3 R = quat_to_mat3(norm4(rotation));
+  mat4 transform = mat4_id();
+  for (int k = 0; k < 3; ++k) {
+    for (int c = 0; c < 3; ++c) {
+      transform.vv[k][c] = R.vv[c][k] * scale.v[k];
+    }
+    transform.vv[3][k] = translation.v[k];
+  }
+  return transform;
+}
+
+static int
+scene_parse_instance(const json_value *desc, size_t n_models,
+                     gsinstance *instance) {
+  double model = json_number(json_get(desc, "model"), -1.0);
+  if (model < 0.0 || model >= n_models) return 0;
+  instance->model = (size_t)model;
+
+  const json_value *matrix = json_get(desc, "matrix");
+  if (matrix) {
+    if (json_length(matrix) != 16) return 0;
+    for (size_t i = 0; i < 16; ++i) {
+      instance->transform.v[i] = json_number(json_at(matrix, i), 0.0);
+    }
+    return 1;
+  }
+
+  vec3f translation = {{0.f, 0.f, 0.f}};
+  vec4f rotation = {{1.f, 0.f, 0.f, 0.f}};
+  vec3f scale = {{1.f, 1.f, 1.f}};
+  const json_value *t = json_get(desc, "translation");
+  const json_value *r = json_get(desc, "rotation");
+  const json_value *s = json_get(desc, "scale");
+  if ((t && json_length(t) != 3) || (r && json_length(r) != 4)) return 0;
+
+  for (size_t j = 0; t && j < 3; ++j) {
+    translation.v[j] = json_number(json_at(t, j), 0.0);
+  }
+  for (size_t j = 0; r && j < 4; ++j) {
+    rotation.v[j] = json_number(json_at(r, j), 0.0);
+  }
+  if (s && json_length(s) == 3) {
+    for (size_t j = 0; j < 3; ++j) {
+      scale.v[j] = json_number(json_at(s, j), 1.0);
+    }
+  } else if (s) {
+    float uniform = json_number(s, 1.0);
+    scale = (vec3f){{uniform, uniform, uniform}};
+  }
+
+  instance->transform = scene_compose_transform(translation, rotation, scale);
+  return 1;
+}
+
+gsscene *
+scene_load(const char *fn, const loader_options *opts) {
+  json_value *desc = json_parse_file(fn);
+  if (!desc) {
+    printf("[scene] unable to parse %s\n", fn);
+    return NULL;
+  }
+
+  /* model paths are relative to the directory of the scene file */
+  const char *slash = strrchr(fn, '/');
+  int dir_len = slash ? (int)(slash - fn) + 1 : 0;
+
+  gsscene *scene = scene_create();
+  scene->owns_models = 1;
+
+  const json_value *models = json_get(desc, "models");
+  int ok = json_length(models) > 0;
+  for (size_t i = 0; ok && i < json_length(models); ++i) {
+    const char *name = json_string(json_at(models, i));
+    char path[SCENE_MAX_PATH];
+    ok = name && snprintf(path, sizeof(path), "%.*s%s", dir_len, fn, name) <
+                     (int)sizeof(path);
+
+    gsmodel *model = ok ? loader_gsmodel_load(path, opts) : NULL;
+    if (model) scene_add_model(scene, model);
+    ok = model != NULL;
+  }
+
+  const json_value *instances = json_get(desc, "instances");
+  for (size_t i = 0; ok && i < json_length(instances); ++i) {
+    gsinstance instance;
+    ok = scene_parse_instance(json_at(instances, i), scene->n_models,
+                              &instance);
+    if (ok) scene_add_instance(scene, instance.model, instance.transform);
+    if (!ok) printf("[scene] invalid instance %zu in %s\n", i, fn);
+  }
+  json_destroy(desc);
+
+  if (!ok || scene->n_instances == 0) {
+    printf("[scene] unable to load %s\n", fn);
+    scene_destroy(scene);
+    return NULL;
+  }
+
+  printf("[scene] loaded %zu models, %zu instances, %zu points\n",
+         scene->n_models, scene->n_instances, scene_num_points(scene));
+  return scene;
+}
+
+void
+scene_destroy(gsscene *scene) {
+  if (!scene) return;
+  if (scene->owns_models) {
+    for (size_t i = 0; i < scene->n_models; ++i) {
+      loader_gsmodel_destroy(scene->models[i]);
+    }
+  }
+  free(scene->models);
+  free(scene->instances);
+  free(scene);
+}
@@ -0,0 +1,163 @@
+#include <math.h>
+#include <splatc/quantize.h>
+#include <splatc/sh.h>
+
+#define SH_C1 0.4886025119029199f
+
+static const float SH_C2[] = {1.0925484305920792f, -1.0925484305920792f,
+                              0.31539156525252005f, -1.0925484305920792f,
+                              0.5462742152960396f};
+
+static const float SH_C3[] = {-0.5900435899266435f, 2.890611442640554f,
+                              -0.4570457994644658f, 0.3731763325901154f,
+                              -0.4570457994644658f, 1.445305721320277f,
+                              -0.5900435899266435f};
+
+size_t
+sh_num_coeffs(int degree) {
+  return (size_t)((degree + 1) * (degree + 1) - 1);
+}
+
+int
+sh_degree_from_rest(size_t n_rest) {
+  for (int degree = 0; degree <= SH_MAX_DEGREE; ++degree) {
+    if (3 * sh_num_coeffs(degree) == n_rest) return degree;
+  }
+  return -1;
+}
+
+/*
+ * Basis functions of a batch of normalized directions in SoA form, one lane
+ * per splat. Each degree builds on the bands of the degree below.
+ */
+static inline void
+sh_basis_deg1(const float *x, const float *y, const float *z,
+              float basis[][SH_BATCH_SIZE]) {
+  for (int l = 0; l < SH_BATCH_SIZE; ++l) {
+    basis[0][l] = -SH_C1 * y[l];
+    basis[1][l] = SH_C1 * z[l];
+    basis[2][l] = -SH_C1 * x[l];
+  }
+}
+
+static inline void
+sh_basis_deg2(const float *x, const float *y, const float *z,
+              float basis[][SH_BATCH_SIZE]) {
+  sh_basis_deg1(x, y, z, basis);
+  for (int l = 0; l < SH_BATCH_SIZE; ++l) {
+    float xx = x[l] * x[l], yy = y[l] * y[l], zz = z[l] * z[l];
+    basis[3][l] = SH_C2[0] * x[l] * y[l];
+    basis[4][l] = SH_C2[1] * y[l] * z[l];
+    basis[5][l] = SH_C2[2] * (2.f * zz - xx - yy);
+    basis[6][l] = SH_C2[3] * x[l] * z[l];
+    basis[7][l] = SH_C2[4] * (xx - yy);
+  }
+}
+
+static inline void
+sh_basis_deg3(const float *x, const float *y, const float *z,
+              float basis[][SH_BATCH_SIZE]) {
+  sh_basis_deg2(x, y, z, basis);
+  for (int l = 0; l < SH_BATCH_SIZE; ++l) {
+    float xx = x[l] * x[l], yy = y[l] * y[l], zz = z[l] * z[l];
+    basis[8][l] = SH_C3[0] * y[l] * (3.f * xx - yy);
+    basis[9][l] = SH_C3[1] * x[l] * y[l] * z[l];
+    basis[10][l] = SH_C3[2] * y[l] * (4.f * zz - xx - yy);
+    basis[11][l] = SH_C3[3] * z[l] * (2.f * zz - 3.f * xx - 3.f * yy);
+    basis[12][l] = SH_C3[4] * x[l] * (4.f * zz - xx - yy);
+    basis[13][l] = SH_C3[5] * z[l] * (xx - yy);
+    basis[14][l] = SH_C3[6] * x[l] * (xx - 3.f * yy);
+  }
+}
+
+#define SH_LOAD_F32(v) (v)
+#define SH_LOAD_F16(v) quantize_half_to_float(v)
+
+/*
+ * Evaluates one batch for a fixed degree. K is a compile time constant so the
+ * lane loops vectorize and the coefficient loop unrolls; lanes past n repeat
+ * the last splat and are not written back. Coefficients are either floats or
+ * half floats of a quantized model.
+ */
+#define SH_EVAL_BATCH(D, K, SUFFIX, T, LOAD)                                  \
+  static void sh_eval_batch_deg##D##SUFFIX(                                   \
+      const T *sh, const uint32_t *idx, const vec3f *dirs, size_t n,          \
+      const vec3f *base_colors, vec3f *colors) {                              \
+    float x[SH_BATCH_SIZE], y[SH_BATCH_SIZE], z[SH_BATCH_SIZE];               \
+    float r[SH_BATCH_SIZE], g[SH_BATCH_SIZE], b[SH_BATCH_SIZE];               \
+    float basis[K][SH_BATCH_SIZE];                                            \
+    const T *coeffs[SH_BATCH_SIZE];                                           \
+                                                                              \
+    for (int l = 0; l < SH_BATCH_SIZE; ++l) {                                 \
+      size_t j = (size_t)l < n ? (size_t)l : n - 1;                           \
+      uint32_t i = idx[j];                                                    \
+      x[l] = dirs[j].x;                                                       \
+      y[l] = dirs[j].y;                                                       \
+      z[l] = dirs[j].z;                                                       \
+      r[l] = base_colors[i].x;                                                \
+      g[l] = base_colors[i].y;                                                \
+      b[l] = base_colors[i].z;                                                \
+      coeffs[l] = sh + (size_t)i * 3 * K;                                     \
+    }                                                                         \
+    for (int l = 0; l < SH_BATCH_SIZE; ++l) {                                 \
+      float len2 = x[l] * x[l] + y[l] * y[l] + z[l] * z[l];                   \
+      float rn = 1.f / sqrtf(fmaxf(len2, 1e-12f));                            \
+      x[l] *= rn;                                                             \
+      y[l] *= rn;                                                             \
+      z[l] *= rn;                                                             \
+    }                                                                         \
+                                                                              \
+    sh_basis_deg##D(x, y, z, basis);                                          \
+                                                                              \
+    for (int k = 0; k < K; ++k) {                                             \
+      for (int l = 0; l < SH_BATCH_SIZE; ++l) {                               \
+        r[l] += basis[k][l] * LOAD(coeffs[l][3 * k + 0]);                     \
+        g[l] += basis[k][l] * LOAD(coeffs[l][3 * k + 1]);                     \
+        b[l] += basis[k][l] * LOAD(coeffs[l][3 * k + 2]);                     \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    for (size_t l = 0; l < n; ++l) {                                          \
+      colors[idx[l]] = (vec3f){{fmaxf(r[l], 0.f), fmaxf(g[l], 0.f),           \
+                                fmaxf(b[l], 0.f)}};                           \
+    }                                                                         \
+  }
+
+SH_EVAL_BATCH(1, 3, , float, SH_LOAD_F32)
+SH_EVAL_BATCH(2, 8, , float, SH_LOAD_F32)
+SH_EVAL_BATCH(3, 15, , float, SH_LOAD_F32)
+SH_EVAL_BATCH(1, 3, _f16, uint16_t, SH_LOAD_F16)
+SH_EVAL_BATCH(2, 8, _f16, uint16_t, SH_LOAD_F16)
+SH_EVAL_BATCH(3, 15, _f16, uint16_t, SH_LOAD_F16)
+
+/* dispatches full batches to the kernel of the given degree */
+#define SH_EVALUATE(SUFFIX, T)                                                \
+  void sh_evaluate##SUFFIX(int degree, const T *sh, const uint32_t *idx,      \
+                           const vec3f *dirs, size_t n,                       \
+                           const vec3f *base_colors, vec3f *colors) {         \
+    for (size_t i = 0; i < n; i += SH_BATCH_SIZE) {                           \
+      size_t batch = n - i < SH_BATCH_SIZE ? n - i : SH_BATCH_SIZE;           \
+      switch (degree) {                                                       \
+        case 1:                                                               \
+          sh_eval_batch_deg1##SUFFIX(sh, idx + i, dirs + i, batch,            \
+                                     base_colors, colors);                    \
+          break;                                                              \
+        case 2:                                                               \
+          sh_eval_batch_deg2##SUFFIX(sh, idx + i, dirs + i, batch,            \
+                                     base_colors, colors);                    \
+          break;                                                              \
+        case 3:                                                               \
+          sh_eval_batch_deg3##SUFFIX(sh, idx + i, dirs + i, batch,            \
+                                     base_colors, colors);                    \
+          break;                                                              \
+        default:                                                              \
+          for (size_t l = 0; l < batch; ++l) {                                \
+            colors[idx[i + l]] = base_colors[idx[i + l]];                     \
+          }                                                                   \
+          break;                                                              \
+      }                                                                       \
+    }                                                                         \
+  }
+
+SH_EVALUATE(, float)
+SH_EVALUATE(_f16, uint16_t)
@@ -0,0 +1,215 @@
+#include <splatc/sort.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SORT_NUM_BUCKETS (1 << SORT_RADIX_BITS)
+#define SORT_MAX_CHUNKS 32
+#define SORT_INSERTION_SLACK 1024 /* keys sorted before the budget applies */
+
+typedef struct {
+  const uint32_t *keys;
+  const uint32_t *values;
+  uint32_t *dst_keys;
+  uint32_t *dst_values;
+  size_t *histograms; /* SORT_NUM_BUCKETS per chunk */
+  int shift;
+} radix_args;
+
+typedef struct {
+  const uint64_t *keys;
+  const uint32_t *values;
+  uint64_t *dst_keys;
+  uint32_t *dst_values;
+  size_t *histograms;
+  int shift;
+} radix64_args;
+
+static void
+sort_histogram_u32(void *arg, size_t chunk, size_t begin, size_t end) {
+  radix_args *args = (radix_args *)arg;
+  size_t *histogram = args->histograms + chunk * SORT_NUM_BUCKETS;
+
+  memset(histogram, 0, SORT_NUM_BUCKETS * sizeof(size_t));
+  for (size_t i = begin; i < end; ++i) {
+    histogram[(args->keys[i] >> args->shift) & (SORT_NUM_BUCKETS - 1)]++;
+  }
+}
+
+static void
+sort_scatter_u32(void *arg, size_t chunk, size_t begin, size_t end) {
+  radix_args *args = (radix_args *)arg;
+  size_t *offsets = args->histograms + chunk * SORT_NUM_BUCKETS;
+
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t key = args->keys[i];
+    size_t dst = offsets[(key >> args->shift) & (SORT_NUM_BUCKETS - 1)]++;
+    args->dst_keys[dst] = key;
+    args->dst_values[dst] = args->values[i];
+  }
+}
+
+static void
+sort_histogram_u64(void *arg, size_t chunk, size_t begin, size_t end) {
+  radix64_args *args = (radix64_args *)arg;
+  size_t *histogram = args->histograms + chunk * SORT_NUM_BUCKETS;
+
+  memset(histogram, 0, SORT_NUM_BUCKETS * sizeof(size_t));
+  for (size_t i = begin; i < end; ++i) {
+    histogram[(args->keys[i] >> args->shift) & (SORT_NUM_BUCKETS - 1)]++;
+  }
+}
+
+static void
+sort_scatter_u64(void *arg, size_t chunk, size_t begin, size_t end) {
+  radix64_args *args = (radix64_args *)arg;
+  size_t *offsets = args->histograms + chunk * SORT_NUM_BUCKETS;
+
+  for (size_t i = begin; i < end; ++i) {
+    uint64_t key = args->keys[i];
+    size_t dst = offsets[(key >> args->shift) & (SORT_NUM_BUCKETS - 1)]++;
+    args->dst_keys[dst] = key;
+    args->dst_values[dst] = args->values[i];
+  }
+}
+
+/*
+ * Turns the per-chunk histograms into the offsets each chunk scatters its
+ * keys to, bucket by bucket and chunk by chunk to keep the sort stable.
+ * Returns 0 if all keys fall into one bucket and the pass can be skipped.
+ */
+static int
+sort_offsets(size_t *histograms, size_t n_chunks, size_t n) {
+  size_t sum = 0;
+  for (size_t b = 0; b < SORT_NUM_BUCKETS; ++b) {
+    size_t bucket = 0;
+    for (size_t c = 0; c < n_chunks; ++c) {
+      bucket += histograms[c * SORT_NUM_BUCKETS + b];
+    }
+    if (bucket == n) return 0;
+
+    for (size_t c = 0; c < n_chunks; ++c) {
+      size_t count = histograms[c * SORT_NUM_BUCKETS + b];
+      histograms[c * SORT_NUM_BUCKETS + b] = sum;
+      sum += count;
+    }
+  }
+  return 1;
+}
+
+static size_t
+sort_num_chunks(tpool *pool, size_t n) {
+  if (!pool) return 1;
+  size_t n_chunks = (n + SORT_MIN_CHUNK_SIZE - 1) / SORT_MIN_CHUNK_SIZE;
+  if (n_chunks > tpool_num_threads(pool)) n_chunks = tpool_num_threads(pool);
+  if (n_chunks > SORT_MAX_CHUNKS) n_chunks = SORT_MAX_CHUNKS;
+  return n_chunks > 0 ? n_chunks : 1;
+}
+
+void
+sort_radix_u32(tpool *pool, uint32_t *keys, uint32_t *values,
+               uint32_t *tmp_keys, uint32_t *tmp_values, size_t n) {
+  size_t n_chunks = sort_num_chunks(pool, n);
+  size_t histograms[SORT_MAX_CHUNKS * SORT_NUM_BUCKETS];
+  radix_args args = {.keys = keys,
+                     .values = values,
+                     .dst_keys = tmp_keys,
+                     .dst_values = tmp_values,
+                     .histograms = histograms,
+                     .shift = 0};
+
+  for (args.shift = 0; args.shift < 32; args.shift += SORT_RADIX_BITS) {
+    tpool_parallel_for(pool, n, n_chunks, sort_histogram_u32, &args);
+    if (!sort_offsets(histograms, n_chunks, n)) continue;
+    tpool_parallel_for(pool, n, n_chunks, sort_scatter_u32, &args);
+
+    const uint32_t *src_keys = args.keys;
+    const uint32_t *src_values = args.values;
+    args.keys = args.dst_keys;
+    args.values = args.dst_values;
+    args.dst_keys = (uint32_t *)src_keys;
+    args.dst_values = (uint32_t *)src_values;
+  }
+
+  /* skipped passes can leave the result in the scratch arrays */
+  if (args.keys != keys) {
+    memcpy(keys, args.keys, n * sizeof(uint32_t));
+    memcpy(values, args.values, n * sizeof(uint32_t));
+  }
+}
+
+void
+sort_radix_u64(tpool *pool, uint64_t *keys, uint32_t *values,
+               uint64_t *tmp_keys, uint32_t *tmp_values, size_t n,
+               int key_bits) {
+  size_t n_chunks = sort_num_chunks(pool, n);
+  size_t histograms[SORT_MAX_CHUNKS * SORT_NUM_BUCKETS];
+  radix64_args args = {.keys = keys,
+                       .values = values,
+                       .dst_keys = tmp_keys,
+                       .dst_values = tmp_values,
+                       .histograms = histograms,
+                       .shift = 0};
+
+  for (args.shift = 0; args.shift < key_bits; args.shift += SORT_RADIX_BITS) {
+    tpool_parallel_for(pool, n, n_chunks, sort_histogram_u64, &args);
+    if (!sort_offsets(histograms, n_chunks, n)) continue;
+    tpool_parallel_for(pool, n, n_chunks, sort_scatter_u64, &args);
+
+    const uint64_t *src_keys = args.keys;
+    const uint32_t *src_values = args.values;
+    args.keys = args.dst_keys;
+    args.values = args.dst_values;
+    args.dst_keys = (uint64_t *)src_keys;
+    args.dst_values = (uint32_t *)src_values;
+  }
+
+  if (args.keys != keys) {
+    memcpy(keys, args.keys, n * sizeof(uint64_t));
+    memcpy(values, args.values, n * sizeof(uint32_t));
+  }
+}
+
+int
+sort_insertion_u32(uint32_t *keys, uint32_t *values, size_t n,
+                   size_t max_shifts_per_key) {
+  size_t shifts = 0;
+  for (size_t i = 1; i < n; ++i) {
+    uint32_t key = keys[i];
+    if (keys[i - 1] <= key) continue;
+
+    uint32_t value = values[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1] > key; --j) {
+      keys[j] = keys[j - 1];
+      values[j] = values[j - 1];
+    }
+    keys[j] = key;
+    values[j] = value;
+
+    /* checked against the prefix so that unsorted input fails early */
+    shifts += i - j;
+    if (shifts > (i + SORT_INSERTION_SLACK) * max_shifts_per_key) return 0;
+  }
+  return 1;
+}
+
+void
+sort_merge_u32(const uint32_t *keys, const uint32_t *values, size_t n_first,
+               size_t n, uint32_t *dst_keys, uint32_t *dst_values) {
+  size_t a = 0;
+  size_t b = n_first;
+  size_t dst = 0;
+  while (a < n_first && b < n) {
+    size_t src = keys[b] < keys[a] ? b++ : a++;
+    dst_keys[dst] = keys[src];
+    dst_values[dst++] = values[src];
+  }
+  for (; a < n_first; ++a, ++dst) {
+    dst_keys[dst] = keys[a];
+    dst_values[dst] = values[a];
+  }
+  for (; b < n; ++b, ++dst) {
+    dst_keys[dst] = keys[b];
+    dst_values[dst] = values[b];
+  }
+}
@@ -0,0 +1,368 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <math.h>
+#include <splatc/sh.h>
+#include <splatc/splatc.h>
+#include <splatc/stream.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STREAM_NOT_RESIDENT UINT64_MAX
+
+typedef struct {
+  splatc_chunk desc;
+  vec3f center;
+  float radius;
+  uint64_t offset;    /* first resident point, or STREAM_NOT_RESIDENT */
+  uint64_t last_used; /* last update the chunk was visible in */
+} stream_chunk;
+
+typedef struct {
+  double key;
+  uint32_t chunk;
+} stream_order;
+
+struct gsstream_t {
+  int fd;
+  uint64_t n_points; /* in the file */
+
+  stream_chunk *chunks;
+  size_t n_chunks;
+
+  /* per-point sections, indexed by splatc_section_kind */
+  uint64_t file_offsets[SPLATC_SECTION_COUNT];
+  uint32_t strides[SPLATC_SECTION_COUNT];
+  uint8_t *arrays[SPLATC_SECTION_COUNT];
+
+  /* resident chunks in the order of their points */
+  uint32_t *resident;
+  size_t n_resident;
+  size_t capacity; /* points */
+
+  gsmodel model;
+  uint64_t frame;
+  stream_order *scratch; /* n_chunks entries */
+  stream_stats stats;
+};
+
+static double
+stream_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+stream_read(int fd, void *dst, size_t size, uint64_t offset) {
+  uint8_t *p = dst;
+  while (size > 0) {
+    ssize_t n = pread(fd, p, size, offset);
+    if (n <= 0) return 0;
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return 1;
+}
+
+static int
+stream_compare_order(const void *a, const void *b) {
+  double ka = ((const stream_order *)a)->key;
+  double kb = ((const stream_order *)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+static size_t
+stream_point_size(const gsstream *stream) {
+  size_t size = 0;
+  for (int kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+    size += stream->strides[kind];
+  }
+  return size;
+}
+
+static void
+stream_bind_model(gsstream *stream, int sh_degree) {
+  gsmodel *model = &stream->model;
+  model->positions = (vec3f *)stream->arrays[SPLATC_SECTION_POSITIONS];
+  model->colors = (vec3f *)stream->arrays[SPLATC_SECTION_COLORS];
+  model->opacities = (float *)stream->arrays[SPLATC_SECTION_OPACITIES];
+  model->scales = (vec3f *)stream->arrays[SPLATC_SECTION_SCALES];
+  model->rotations = (vec4f *)stream->arrays[SPLATC_SECTION_ROTATIONS];
+  model->sh = (float *)stream->arrays[SPLATC_SECTION_SH];
+  model->sh_degree = sh_degree;
+  model->n_points = 0;
+}
+
+/* checks the header and reads the chunk table */
+static int
+stream_read_header(gsstream *stream, const splatc_header *header,
+                   uint64_t file_size) {
+  if (memcmp(header->magic, SPLATC_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != SPLATC_VERSION ||
+      header->n_sections > SPLATC_MAX_SECTIONS ||
+      header->sh_degree > SH_MAX_DEGREE)
+    return 0;
+
+  const uint32_t expected[SPLATC_SECTION_COUNT] = {
+      [SPLATC_SECTION_POSITIONS] = sizeof(vec3f),
+      [SPLATC_SECTION_COLORS] = sizeof(vec3f),
+      [SPLATC_SECTION_OPACITIES] = sizeof(float),
+      [SPLATC_SECTION_SCALES] = sizeof(vec3f),
+      [SPLATC_SECTION_ROTATIONS] = sizeof(vec4f),
+      [SPLATC_SECTION_SH] =
+          3 * sh_num_coeffs(header->sh_degree) * sizeof(float),
+      [SPLATC_SECTION_CHUNKS] = sizeof(splatc_chunk),
+  };
+
+  const splatc_section *chunk_section = NULL;
+  for (uint32_t i = 0; i < header->n_sections; ++i) {
+    const splatc_section *section = &header->sections[i];
+    if (section->kind >= SPLATC_SECTION_COUNT ||
+        section->stride != expected[section->kind] || section->stride == 0 ||
+        section->offset + section->size > file_size)
+      return 0;
+
+    if (section->kind == SPLATC_SECTION_CHUNKS) {
+      chunk_section = section;
+    } else if (section->size == section->stride * header->n_points) {
+      stream->file_offsets[section->kind] = section->offset;
+      stream->strides[section->kind] = section->stride;
+    } else {
+      return 0;
+    }
+  }
+
+  for (int kind = 0; kind < SPLATC_SECTION_CHUNKS; ++kind) {
+    if (!stream->strides[kind] &&
+        (kind != SPLATC_SECTION_SH || header->sh_degree > 0))
+      return 0;
+  }
+  if (!chunk_section || chunk_section->size % sizeof(splatc_chunk) != 0)
+    return 0;
+
+  stream->n_points = header->n_points;
+  stream->n_chunks = chunk_section->size / sizeof(splatc_chunk);
+  splatc_chunk *descs = malloc(chunk_section->size);
+  stream->chunks = calloc(stream->n_chunks, sizeof(stream_chunk));
+  int ok = descs && stream->chunks &&
+           stream_read(stream->fd, descs, chunk_section->size,
+                       chunk_section->offset);
+
+  for (size_t c = 0; ok && c < stream->n_chunks; ++c) {
+    stream_chunk *chunk = &stream->chunks[c];
+    chunk->desc = descs[c];
+    chunk->offset = STREAM_NOT_RESIDENT;
+
+    vec3f extent;
+    for (int j = 0; j < 3; ++j) {
+      float lo = descs[c].bounds_min[j], hi = descs[c].bounds_max[j];
+      chunk->center.v[j] = 0.5f * (lo + hi);
+      extent.v[j] = hi - lo;
+    }
+    chunk->radius = 0.5f * sqrtf(dot3(extent, extent));
+    ok = descs[c].begin + descs[c].count <= header->n_points;
+  }
+  free(descs);
+  return ok;
+}
+
+gsstream *
+stream_open(const char *fn, size_t budget) {
+  gsstream *stream = calloc(1, sizeof(gsstream));
+  if (!stream) {
+    printf("[stream] unable to allocate the stream of %s\n", fn);
+    return NULL;
+  }
+  stream->fd = open(fn, O_RDONLY);
+
+  struct stat st;
+  splatc_header header;
+  int ok = stream->fd >= 0 && fstat(stream->fd, &st) == 0 &&
+           (size_t)st.st_size >= sizeof(header) &&
+           stream_read(stream->fd, &header, sizeof(header), 0) &&
+           stream_read_header(stream, &header, st.st_size);
+  if (!ok) {
+    printf("[stream] %s is not a chunked .splatc file\n", fn);
+    stream_close(stream);
+    return NULL;
+  }
+
+  stream->capacity = budget / stream_point_size(stream);
+  for (int kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+    if (!stream->strides[kind]) continue;
+    stream->arrays[kind] = malloc(stream->capacity * stream->strides[kind]);
+    ok = ok && stream->arrays[kind];
+  }
+  stream->resident = malloc(stream->n_chunks * sizeof(uint32_t));
+  stream->scratch = malloc(stream->n_chunks * sizeof(stream_order));
+  if (!ok || !stream->resident || !stream->scratch) {
+    printf("[stream] unable to allocate %zu resident points\n",
+           stream->capacity);
+    stream_close(stream);
+    return NULL;
+  }
+  stream_bind_model(stream, header.sh_degree);
+
+  printf("[stream] %s: %llu points in %zu chunks, %zu resident points\n", fn,
+         (unsigned long long)stream->n_points, stream->n_chunks,
+         stream->capacity);
+  return stream;
+}
+
+gsmodel *
+stream_model(gsstream *stream) {
+  return &stream->model;
+}
+
+/* conservative sphere against frustum test in view space */
+static int
+stream_chunk_visible(const stream_chunk *chunk, mat4 view, const camera *cam,
+                     float tan_fovx, float tan_fovy) {
+  vec4f c = matmulv4(view, (vec4f){{chunk->center.x, chunk->center.y,
+                                    chunk->center.z, 1.f}});
+  float r = chunk->radius;
+  if (c.z + r < cam->near || c.z - r > cam->far) return 0;
+  if (fabsf(c.x) - c.z * tan_fovx > r * sqrtf(1.f + tan_fovx * tan_fovx))
+    return 0;
+  if (fabsf(c.y) - c.z * tan_fovy > r * sqrtf(1.f + tan_fovy * tan_fovy))
+    return 0;
+  return 1;
+}
+
+/* moves the remaining resident chunks down over the evicted ones */
+static void
+stream_compact(gsstream *stream) {
+  size_t n_kept = 0;
+  uint64_t cursor = 0;
+  for (size_t i = 0; i < stream->n_resident; ++i) {
+    stream_chunk *chunk = &stream->chunks[stream->resident[i]];
+    if (chunk->offset == STREAM_NOT_RESIDENT) continue;
+
+    if (chunk->offset != cursor) {
+      for (int kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+        size_t stride = stream->strides[kind];
+        if (!stride) continue;
+        memmove(stream->arrays[kind] + cursor * stride,
+                stream->arrays[kind] + chunk->offset * stride,
+                chunk->desc.count * stride);
+      }
+      chunk->offset = cursor;
+    }
+    cursor += chunk->desc.count;
+    stream->resident[n_kept++] = stream->resident[i];
+  }
+  stream->n_resident = n_kept;
+  stream->model.n_points = cursor;
+}
+
+static int
+stream_load(gsstream *stream, uint32_t c) {
+  stream_chunk *chunk = &stream->chunks[c];
+  uint64_t offset = stream->model.n_points;
+
+  double start = stream_now();
+  for (int kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+    size_t stride = stream->strides[kind];
+    if (!stride) continue;
+
+    size_t size = chunk->desc.count * stride;
+    if (!stream_read(stream->fd, stream->arrays[kind] + offset * stride, size,
+                     stream->file_offsets[kind] + chunk->desc.begin * stride)) {
+      printf("[stream] unable to read chunk %u\n", c);
+      return 0;
+    }
+    stream->stats.bytes_read += size;
+  }
+  stream->stats.read_time += stream_now() - start;
+  stream->stats.n_loaded++;
+
+  chunk->offset = offset;
+  stream->resident[stream->n_resident++] = c;
+  stream->model.n_points += chunk->desc.count;
+  return 1;
+}
+
+void
+stream_update(gsstream *stream, camera *camera) {
+  mat4 view = camera_get_view(camera);
+  float tan_fovy = tanf(camera->fovy * 0.5f);
+  float tan_fovx = tan_fovy * camera->aspect;
+  uint64_t frame = ++stream->frame;
+
+  /* visible chunks that are missing, nearest first */
+  size_t n_missing = 0;
+  uint64_t missing_points = 0;
+  for (size_t c = 0; c < stream->n_chunks; ++c) {
+    stream_chunk *chunk = &stream->chunks[c];
+    if (!stream_chunk_visible(chunk, view, camera, tan_fovx, tan_fovy))
+      continue;
+
+    chunk->last_used = frame;
+    stream->stats.n_requests++;
+    if (chunk->offset != STREAM_NOT_RESIDENT) {
+      stream->stats.n_hits++;
+      continue;
+    }
+
+    vec3f d = sub3(chunk->center, camera->pos);
+    stream->scratch[n_missing++] = (stream_order){dot3(d, d), c};
+    missing_points += chunk->desc.count;
+  }
+  if (n_missing == 0) return;
+  qsort(stream->scratch, n_missing, sizeof(stream_order), stream_compare_order);
+
+  /* evict chunks that were not visible in this update, least recent first */
+  uint64_t free_points = stream->capacity - stream->model.n_points;
+  if (free_points < missing_points) {
+    stream_order *victims = stream->scratch + n_missing;
+    size_t n_victims = 0;
+    for (size_t i = 0; i < stream->n_resident; ++i) {
+      uint32_t c = stream->resident[i];
+      if (stream->chunks[c].last_used == frame) continue;
+      victims[n_victims++] = (stream_order){stream->chunks[c].last_used, c};
+    }
+    qsort(victims, n_victims, sizeof(stream_order), stream_compare_order);
+
+    for (size_t i = 0; i < n_victims && free_points < missing_points; ++i) {
+      stream_chunk *chunk = &stream->chunks[victims[i].chunk];
+      chunk->offset = STREAM_NOT_RESIDENT;
+      free_points += chunk->desc.count;
+      stream->stats.n_evicted++;
+    }
+    if (n_victims > 0) stream_compact(stream);
+  }
+
+  for (size_t i = 0; i < n_missing; ++i) {
+    uint32_t c = stream->scratch[i].chunk;
+    if (stream->model.n_points + stream->chunks[c].desc.count >
+            stream->capacity ||
+        !stream_load(stream, c)) {
+      stream->stats.n_dropped++;
+    }
+  }
+}
+
+stream_stats
+stream_get_stats(const gsstream *stream) {
+  return stream->stats;
+}
+
+void
+stream_close(gsstream *stream) {
+  if (!stream) return;
+  if (stream->fd >= 0) close(stream->fd);
+  for (int kind = 0; kind < SPLATC_SECTION_COUNT; ++kind) {
+    free(stream->arrays[kind]);
+  }
+  free(stream->chunks);
+  free(stream->resident);
+  free(stream->scratch);
+  free(stream);
+}
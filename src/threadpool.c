@@ -14,6 +14,22 @@ typedef struct tpool_work {
 };
 typedef struct tpool_work tpool_work;
 
+/* one tpool_parallel_for call, waited on by the calling thread */
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cond;
+  size_t remaining; /* ranges not done yet */
+} tpool_call;
+
+typedef struct {
+  range_func_t func;
+  void *arg;
+  size_t chunk;
+  size_t begin;
+  size_t end;
+  tpool_call *call;
+} tpool_range;
+
 struct tpool {
   tpool_work *work_first;
   tpool_work *work_last;
@@ -192,3 +208,95 @@ tpool_wait(tpool *tm) {
   }
   pthread_mutex_unlock(&(tm->work_mutex));
 }
+
+size_t
+tpool_num_threads(tpool *tm) {
+  if (tm == NULL) return 1;
+  return tm->thread_cnt;
+}
+
+static void
+tpool_range_run(tpool_range *range) {
+  range->func(range->arg, range->chunk, range->begin, range->end);
+
+  tpool_call *call = range->call;
+  pthread_mutex_lock(&(call->mutex));
+  if (--call->remaining == 0) pthread_cond_signal(&(call->done_cond));
+  pthread_mutex_unlock(&(call->mutex));
+}
+
+static void
+tpool_range_worker(void *arg) {
+  tpool_range_run(arg);
+}
+
+/* unlinks a range of call that no worker has picked up, NULL if none is left */
+static tpool_range *
+tpool_take_range(tpool *tm, const tpool_call *call) {
+  pthread_mutex_lock(&(tm->work_mutex));
+  tpool_work *prev = NULL;
+  tpool_work *work = tm->work_first;
+  while (work != NULL && !(work->func == tpool_range_worker &&
+                           ((tpool_range *)work->arg)->call == call)) {
+    prev = work;
+    work = work->next;
+  }
+  if (work != NULL) {
+    if (prev == NULL) {
+      tm->work_first = work->next;
+    } else {
+      prev->next = work->next;
+    }
+    if (tm->work_last == work) tm->work_last = prev;
+    if (tm->work_first == NULL && tm->working_cnt == 0)
+      pthread_cond_signal(&(tm->working_cond));
+  }
+  pthread_mutex_unlock(&(tm->work_mutex));
+
+  if (work == NULL) return NULL;
+  tpool_range *range = work->arg;
+  tpool_work_destroy(work);
+  return range;
+}
+
+/*
+ * Waits for the ranges of this call only, not for other work on the pool. The
+ * calling thread runs the ranges no worker has picked up yet itself, so that a
+ * call from inside a worker cannot wait on workers that are all blocked.
+ */
+void
+tpool_parallel_for(tpool *tm, size_t n, size_t n_chunks, range_func_t func,
+                   void *arg) {
+  if (n_chunks == 0) n_chunks = 1;
+
+  if (tm == NULL || n_chunks == 1) {
+    for (size_t c = 0; c < n_chunks; ++c) {
+      func(arg, c, c * n / n_chunks, (c + 1) * n / n_chunks);
+    }
+    return;
+  }
+
+  tpool_call call;
+  pthread_mutex_init(&(call.mutex), NULL);
+  pthread_cond_init(&(call.done_cond), NULL);
+  call.remaining = n_chunks;
+
+  tpool_range *ranges = malloc(n_chunks * sizeof(tpool_range));
+  for (size_t c = 0; c < n_chunks; ++c) {
+    ranges[c] = (tpool_range){func, arg, c, c * n / n_chunks,
+                              (c + 1) * n / n_chunks, &call};
+    tpool_add_work(tm, tpool_range_worker, &ranges[c]);
+  }
+
+  tpool_range *range;
+  while ((range = tpool_take_range(tm, &call)) != NULL) tpool_range_run(range);
+
+  pthread_mutex_lock(&(call.mutex));
+  while (call.remaining != 0)
+    pthread_cond_wait(&(call.done_cond), &(call.mutex));
+  pthread_mutex_unlock(&(call.mutex));
+
+  pthread_mutex_destroy(&(call.mutex));
+  pthread_cond_destroy(&(call.done_cond));
+  free(ranges);
+}